@@ -27,9 +27,41 @@
 #include "common/extra_utils.h"
 #include "control/PGN.h"
 #include "control/XBoard.h"
+#include "model/HashTable.h"
+#include "model/Tablebase.h"
+#include "player/MonteCarloTree.h"
 
 void test();
 
+//search settings of the command line, -1 if a limit wasn't given
+typedef struct {
+    int threads;
+    int parallel_search;
+    int max_depth;
+    int max_time;
+    int max_nodes;
+    int multi_pv;
+} search_options;
+
+/*
+ * Passes the search settings from the command line to the CLI or to XBoard.
+ */
+template <class T>
+void set_options(T& control, const search_options& options) {
+    control.set_threads(options.threads);
+    control.set_parallel_search(options.parallel_search);
+    if (options.max_depth > 0) {
+        control.set_max_search_depth(options.max_depth);
+    }
+    if (options.max_time >= 0) {
+        control.set_max_thinking_time(options.max_time);
+    }
+    if (options.max_nodes >= 0) {
+        control.set_max_nodes(options.max_nodes);
+    }
+    control.set_multi_pv(options.multi_pv);
+}
+
 int main(int argc, char **argv) {
 #ifdef DEBUG
     cerr << "!!!!!!!!!!!!!!!!!!!!!!!!\n";
@@ -40,26 +72,104 @@ int main(int argc, char **argv) {
     init_globals();
     bool cli_mode = false;
     int user_option = 0;
-    if (argc > 1) {
-        string tmp(argv[1]);
+    int hash_size = DEFAULT_HASH_SIZE;
+    string shared_hash = "";
+    bool keep_shared_hash = false;
+    //next to the executable (xboard starts us in bin/ for the book, but the
+    //working directory could be anything), in memory only if we don't know
+    string program(argv[0]);
+    size_t slash = program.rfind('/');
+    string tablebase_file = slash == string::npos ? "" : program.substr(0, slash + 1) + TABLEBASE_FILE;
+    search_options options;
+    options.threads = 1;
+    options.parallel_search = SMP_LAZY;
+    options.max_depth = -1;
+    options.max_time = -1;
+    options.max_nodes = -1;
+    options.multi_pv = 1;
+    for (int i = 1; i < argc; i++) {
+        string tmp(argv[i]);
         if (tmp == "cli") {
             cli_mode = true;
+        } else if (tmp == "-hash" && i + 1 < argc) {
+            //size of the transposition table in MB
+            hash_size = atoi(argv[++i]);
+        } else if (tmp == "-shm" && i + 1 < argc) {
+            //name of a shared transposition table, e.g. "/chess-at-nite"
+            shared_hash = argv[++i];
+            if (shared_hash[0] != '/') {
+                shared_hash = "/" + shared_hash;
+            }
+        } else if (tmp == "-threads" && i + 1 < argc) {
+            //threads of the search
+            options.threads = atoi(argv[++i]);
+        } else if (tmp == "-smp" && i + 1 < argc) {
+            //"lazy", "split" or "mcts"
+            string algorithm(argv[++i]);
+            options.parallel_search = algorithm == "split" ? SMP_SPLIT_POINTS
+                    : algorithm == "mcts" ? SMP_MCTS : SMP_LAZY;
+        } else if (tmp == "-mcts-memory" && i + 1 < argc) {
+            //size of the Monte Carlo tree in MB
+            mcts_memory = atoi(argv[++i]);
+        } else if (tmp == "-depth" && i + 1 < argc) {
+            //fixed depth, without a time limit unless -time is given too
+            options.max_depth = atoi(argv[++i]);
+        } else if (tmp == "-time" && i + 1 < argc) {
+            //exactly that many seconds per move, 0 is no limit
+            options.max_time = atoi(argv[++i]);
+        } else if (tmp == "-nodes" && i + 1 < argc) {
+            //node limit instead of the time, the search is repeatable
+            options.max_nodes = atoi(argv[++i]);
+        } else if (tmp == "-multipv" && i + 1 < argc) {
+            //show the best N moves of the root
+            options.multi_pv = atoi(argv[++i]);
+        } else if (tmp == "-param" && i + 1 < argc) {
+            //tuning of the search, e.g. "futility=150"
+            if (!set_search_parameter(argv[++i])) {
+                std::cerr << "Unknown search parameter: " << argv[i] << std::endl;
+            }
+        } else if (tmp == "-tablebases" && i + 1 < argc) {
+            //file of the endgame tablebases, "" to keep them in memory only
+            tablebase_file = argv[++i];
+        } else if (tmp == "-shm-keep") {
+            //leave the shared table for the next engines when we are done
+            keep_shared_hash = true;
         } else {
-            user_option = atoi(argv[1]);
+            user_option = atoi(argv[i]);
         }
     }
+    if (hash_size < 1) {
+        hash_size = DEFAULT_HASH_SIZE;
+    }
+    if (options.max_depth > 0 && options.max_time < 0) {
+        options.max_time = 0;
+    }
+#ifdef USE_HASH_TABLE
+    if (shared_hash.empty()) {
+        hash_table.allocate(hash_size);
+    } else {
+        hash_table.attach_shared(shared_hash, hash_size, keep_shared_hash);
+    }
+#endif
+#ifdef USE_TABLEBASES
+    tablebases.init(options.threads, tablebase_file);
+#endif
 
 #ifdef COMMAND_LINE
     if (cli_mode) {
         CLI cli;
+        set_options(cli, options);
         cli.start();
     } else if (user_option > 0) {
         CLI cli;
+        set_options(cli, options);
         cli.start(user_option);
     } else {
         XBoard xboard;
+        set_options(xboard, options);
         if (!xboard.start()) {
             CLI cli;
+            set_options(cli, options);
             cli.start();
         }
     }
@@ -28,26 +28,139 @@
 #define SHOW_SEARCH_INFO
 
 // use features
-#define USE_HASH_TABLE_
+#define USE_HASH_TABLE
 #define USE_OPENING_BOOK
+#define USE_NULL_MOVE
+#define USE_TABLEBASES
+//verify the null move cutoffs of deep nodes with a reduced normal search
+//#define USE_NULL_MOVE_VERIFICATION
 
-#ifndef WIN32
 #define UNICODE
-#endif
 
 //time in seconds
 #define DEFAULT_THINKING_TIME  16
+//time management with a clock (in ms, or factors of the soft limit)
+//left on the clock for the communication with the GUI
+#define TIME_SAFETY_MARGIN     100
+//moves we plan with if the whole game has to be played in the time
+#define TIME_MOVES_TO_GO        30
+//the hard limit is 4x the soft one, but never more than 1/4 of the clock
+#define TIME_HARD_FACTOR         4
+//even with the clock nearly out a move gets that much (and a part of the
+//increment that the clock can pay)
+#define TIME_MINIMUM             5
+//the best move didn't change in so many iterations.. use half of the time
+#define TIME_STABLE_ITERATIONS   3
+//the score dropped so much in the last iteration.. use twice the time
+#define TIME_SCORE_DROP         30
+//the next iteration takes about this times longer than the last one
+#define TIME_BRANCHING           2
 //this should be big.. because of the quiescence search.. depth is only
 //affecting the iterations.. and we are using this constant to define the pv
 #define MAX_SEARCH_DEPTH       20
+//depth of the analysis mode.. alpha_beta never goes deeper than the depth of
+//the iteration, the rest of MAX_PLY is left for the quiescence search
+#define ANALYSIS_MAX_DEPTH     40
+//most lines of the multi-PV mode
+#define MAX_MULTI_PV           8
 // do not change!
 #define MAX_PLY 64
 
+//size of the transposition table in MB
+#define DEFAULT_HASH_SIZE 64
+//size of the table of the mate solver in MB
+#define DEFAULT_MATE_TABLE_SIZE 32
+//the mate solver test searches for mates in up to so many moves, with so
+//many nodes at most per position
+#define MATE_SOLVER_MAX_MOVES 8
+#define MATE_SOLVER_NODES 2000000
+//longest mate of the "Solve a Mate" menu
+#define MATE_SOLVER_LONGEST 30
+//memory of the Monte Carlo tree in MB, one half holds the tree of the search
+//and the other one gets the part that is kept for the next move
+#define DEFAULT_MCTS_MEMORY 256
+//exploration of PUCT, and the value of an unvisited move below its parent
+#define MCTS_CPUCT          1.5
+#define MCTS_FPU_REDUCTION  0.2
+//centipawns of the sigmoid that turns a score into the chance to win, and
+//of the softmax of the priors
+#define MCTS_SCORE_SCALE    200.0
+#define MCTS_PRIOR_SCALE    100.0
+//deepest line of the tree (the quiescence search goes on from there)
+#define MCTS_MAX_DEPTH      32
+//visits of a leaf before it gets its children
+#define MCTS_EXPAND_VISITS  4
+//playouts of the main thread between the looks at the limits
+#define MCTS_BATCH          16
+//seconds per thread count of the threads benchmark
+#define MCTS_BENCHMARK_TIME 10
+//endings with up to so many pieces (kings included) are in the tablebases
+#define TB_MAX_PIECES 4
+
+//upper limit for the threads of a parallel search
+#define MAX_THREADS 64
+//parallel search algorithms
+#define SMP_LAZY          0
+#define SMP_SPLIT_POINTS  1
+//Monte Carlo tree search (PUCT) of all the threads instead of alpha-beta
+#define SMP_MCTS          2
+//no split points near the leaves, it's not worth to copy the board there
+#define SPLIT_MIN_DEPTH   3
+
+//depth reduction of the null move.. one more above NULL_MOVE_DEEP
+#define NULL_MOVE_REDUCTION  2
+#define NULL_MOVE_DEEP       6
+//the null move cutoffs from this depth on are verified
+#define NULL_MOVE_VERIFY_DEPTH 5
+
+//late move reductions: quiet moves after the first LMR_MIN_MOVES of a node
+//with at least LMR_MIN_DEPTH are searched with less depth first
+#define LMR_MIN_DEPTH   3
+#define LMR_MIN_MOVES   3
+//size of the reduction table [depth][move number]
+#define LMR_DEPTHS      64
+
+//aspiration windows around the score of the previous iteration, from this
+//depth on.. the window is doubled on every fail, above the max it is full
+#define ASPIRATION_MIN_DEPTH   4
+#define ASPIRATION_WINDOW     30
+#define ASPIRATION_MAX_WINDOW 800
+
+//pruning near the leaves by the static evaluation: up to which depth, and
+//the default margins per ply of depth (they can be changed at runtime)
+#define REVERSE_FUTILITY_DEPTH   3
+#define FUTILITY_DEPTH           2
+#define RAZOR_DEPTH              2
+#define REVERSE_FUTILITY_MARGIN  120
+#define FUTILITY_MARGIN          150
+#define RAZOR_MARGIN             250
+//a capture in the quiescence search has to bring the evaluation this close
+//to alpha (delta pruning)
+#define DELTA_MARGIN             200
+
+//internal iterative deepening of the nodes without a hash move, from this
+//depth on for the PV nodes (depth - 2) and the null window nodes (depth / 2)
+#define IID_PV_DEPTH   4
+#define IID_DEPTH      7
+
+//upper limit for the moves of a position
+#define MAX_MOVES       256
+//move ordering of the quiet moves: killers are before any history count
+#define KILLER_SCORE    (1 << 30)
+#define HISTORY_MAX     (1 << 20)
+//pieces of both colors (and EMPTY) as an index of a table, and the squares
+//of the 8x8 board
+#define PIECE_INDEXES   13
+#define PIECE_INDEX(p)  ((p) + 6)
+#define SQUARES         64
+#define SQUARE_INDEX(s) (RANK(s) * 8 + FILE(s))
+
 //File consts
 #define OPENING_BOOK_FILE    "book"
 #define WAC_FILE             "wac"
 #define LAST_PGN_FILE        "last_game.pgn"
 #define IN_PROGRESS_PGN_FILE "game_in_progress.pgn"
+#define TABLEBASE_FILE       "tablebases"
 #define MAX_FILE_WIDTH            80
 
 //should be 128 because of the 0x88 but the last 8 bytes are not used
@@ -63,6 +176,8 @@
 #define DEFAULT_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 //the game of the century.. move 18
 #define BENCHMARK_FEN "r3r1k1/pp3pbp/1qp1b1p1/2B5/2BP4/Q1n2N2/P4PPP/3R1K1R w - - 0 18"
+//depth of the threads benchmark
+#define BENCHMARK_DEPTH 12
 
 #define NO_SQUARE -1
 
@@ -120,9 +235,21 @@
 #define BISHOP_VALUE    300
 #define KNIGHT_VALUE    300
 #define PAWN_VALUE      100
+//only for the static exchange evaluation, the king is never captured
+#define KING_VALUE    20000
 
 #define MATE          24000
+//score of the side to move when it is mated at ply plies from the root. All
+//the mates are beyond MATE and the shorter ones are better
+#define MATED_IN(ply) (-(MATE + MAX_PLY - (ply)))
 #define DRAW              0
+//won ending of the tablebases that is too long for a mate score (or only
+//wins a pawn promotion), minus the plies to the goal
+#define TABLEBASE_WIN 20000
+//lowest tablebase win (the distances are below 256 plies). The mates and the
+//tablebase wins are the scores relative to the root, the evaluation never
+//gets that high
+#define TABLEBASE_WIN_MIN (TABLEBASE_WIN - 1000)
 
 // pieces
 //!! don't change !!!
@@ -169,6 +296,9 @@
 // typedef for a byte
 typedef signed char byte;
 
+// 64 bit hash keys
+typedef unsigned long long u64;
+
 // squares for the 0x88 board
 typedef enum _SQUARE {
     A1 = 0, A2 = 16, A3 = 32, A4 = 48, A5 = 64, A6 = 80,  A7 = 96, A8 = 112,
@@ -206,28 +336,11 @@ typedef struct _HISTORY_ITEM {
     int black_castle;
     int en_passant;
     int fifty_moves;
-    int hash;
+    //hash of the position after and before the move
+    u64 hash;
+    u64 previous_hash;
 } history_item;
 
-#ifdef USE_HASH_TABLE
-// hash table
-#define HT_SIZE (1<<24)
-
-enum htype {
-    NO, EXACT, LOWER, UPPER
-};
-
-typedef struct {
-    int score;
-    int depth;
-    int wtm;
-    int key;
-    move best;
-    htype type;
-
-} htentry;
-#endif
-
 // rank and file value of a square
 #define RANK(s) (s >> 4)
 #define FILE(s) (s & 7)
@@ -14,13 +14,8 @@
 #ifndef GLOBALS_H_
 #define GLOBALS_H_
 
-#ifndef WIN32
 #include <unistd.h>
 #define get_current_dir getcwd
-#else
-#include <direct.h>
-#define get_current_dir _getcwd
-#endif
 
 #include <stdio.h>  /* defines FILENAME_MAX */
 #include <string.h>
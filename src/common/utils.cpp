@@ -335,6 +335,10 @@ bool operator ==(const move& m1, const move& m2) {
     return (m1.pos_new == m2.pos_new) && (m1.pos_old == m2.pos_old);
 }
 
+bool is_same_move(const move& m1, const move& m2) {
+    return m1 == m2 && (m1.special != MOVE_PROMOTION || m1.promoted == m2.promoted);
+}
+
 bool is_legal_move(const std::vector<move>& moves, move& m) {
     for (std::vector<move>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
         if (*it == m) {
@@ -463,19 +467,33 @@ std::string int_to_string(int i) {
     return ss.str();
 }
 
-int hash_rand() {
-    int i;
-    int r = 0;
-
-    for (i = 0; i < 32; ++i)
-        r ^= rand() << i;
-    return r;
+/*
+ * Pseudo random numbers for the hash keys (xorshift64*). It has a fixed seed,
+ * so every engine computes the same keys for the same position and they can
+ * share a transposition table.
+ */
+u64 hash_rand() {
+    static u64 state = 0x9E3779B97F4A7C15ULL;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
 }
 
+/*
+ * Milliseconds of a monotonic clock since the first call. It doesn't jump
+ * with the time of the system, and it fits into an int for 24 days.
+ */
 int get_ms() {
-    struct timeb timebuffer;
-    ftime(&timebuffer);
-    return (timebuffer.time * 1000) +timebuffer.millitm;
+    static bool started = false;
+    static time_t start;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!started) {
+        start = now.tv_sec;
+        started = true;
+    }
+    return (int) (now.tv_sec - start) * 1000 + now.tv_nsec / 1000000;
 }
 
 void print_help() {
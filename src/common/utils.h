@@ -20,7 +20,6 @@
 #include <iomanip>
 #include <stdlib.h>
 #include <sstream>
-#include <sys/timeb.h>
 #include <stdio.h>
 
 #include "define.h"
@@ -48,6 +47,8 @@ extern std::string move_to_string_very_basic(const move& m);
 extern std::string string_to_lower(std::string str);
 extern int get_promoted_piece(const char piece);
 bool operator == (const move& m1, const move& m2);
+//== compares only the squares, this tells the promotions apart too
+extern bool is_same_move(const move& m1, const move& m2);
 
 extern void print_moves(const std::vector<move>& moves);
 extern void print_history(const std::vector<std::string>& history);
@@ -56,7 +57,7 @@ extern bool is_legal_move(const std::vector<move>& moves, move& m);
 
 extern int get_ms();
 
-extern int hash_rand();
+extern u64 hash_rand();
 extern move string_to_move(const std::string& text);
 extern void print_help();
 
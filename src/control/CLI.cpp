@@ -16,6 +16,7 @@
 using std::cout;
 using std::cerr;
 using std::cin;
+using std::ws;
 using std::endl;
 using std::setw;
 using std::ofstream;
@@ -35,6 +36,10 @@ void CLI::init() {
     inverse_board = false;
     max_thinking_time = DEFAULT_THINKING_TIME;
     max_search_depth = MAX_SEARCH_DEPTH;
+    max_nodes = 0;
+    multi_pv = 1;
+    threads = 1;
+    parallel_search = SMP_LAZY;
     show_best_score = false;
     show_thinking = false;
     loaded_game = false;
@@ -53,6 +58,30 @@ void CLI::start(int option) {
     }
 }
 
+void CLI::set_threads(int count) {
+    threads = count < 1 ? 1 : (count > MAX_THREADS ? MAX_THREADS : count);
+}
+
+void CLI::set_parallel_search(int algorithm) {
+    parallel_search = algorithm;
+}
+
+void CLI::set_max_thinking_time(int seconds) {
+    max_thinking_time = seconds < 0 ? 0 : seconds;
+}
+
+void CLI::set_max_search_depth(int depth) {
+    max_search_depth = depth > 0 ? depth : MAX_SEARCH_DEPTH;
+}
+
+void CLI::set_max_nodes(int nodes) {
+    max_nodes = nodes < 0 ? 0 : nodes;
+}
+
+void CLI::set_multi_pv(int lines) {
+    multi_pv = lines < 1 ? 1 : (lines > MAX_MULTI_PV ? MAX_MULTI_PV : lines);
+}
+
 void CLI::read_settings() {
     int user_option = -1;
     while (user_option != QUIT) {
@@ -83,6 +112,21 @@ void CLI::apply_settings(int option) {
         case SET_SHOW_THINKING:
             show_thinking = !show_thinking;
             break;
+        case SET_THREADS:
+            set_threads_from_user();
+            break;
+        case SET_PARALLEL_SEARCH:
+            parallel_search = (parallel_search + 1) % 3;
+            break;
+        case SET_SEARCH_PARAMETER:
+            set_parameter_from_user();
+            break;
+        case SET_MAX_NODES:
+            set_max_nodes_from_user();
+            break;
+        case SET_MULTI_PV:
+            set_multi_pv_from_user();
+            break;
     }
 }
 
@@ -156,13 +200,21 @@ void CLI::init_game(int game_type) {
     //something went totally wrong...
     white_player->set_max_thinking_time(max_thinking_time);
     white_player->set_max_search_depth(max_search_depth);
+    white_player->set_max_nodes(max_nodes);
+    white_player->set_multi_pv(multi_pv);
     white_player->set_show_best_score(show_best_score);
     white_player->set_show_thinking(show_thinking);
+    white_player->set_threads(threads);
+    white_player->set_parallel_search(parallel_search);
 
     black_player->set_max_thinking_time(max_thinking_time);
     black_player->set_max_search_depth(max_search_depth);
+    black_player->set_max_nodes(max_nodes);
+    black_player->set_multi_pv(multi_pv);
     black_player->set_show_best_score(show_best_score);
     black_player->set_show_thinking(show_thinking);
+    black_player->set_threads(threads);
+    black_player->set_parallel_search(parallel_search);
 }
 
 void CLI::apply_option(int option) {
@@ -187,6 +239,12 @@ void CLI::apply_option(int option) {
         case WAC:
             run_wac_test();
             break;
+        case MATE_SOLVER:
+            run_mate_solver_test();
+            break;
+        case SOLVE_MATE:
+            run_mate_solver();
+            break;
         case SETTINGS:
             read_settings();
             break;
@@ -207,6 +265,8 @@ void CLI::show_options() {
     cout << "   7. Run Benchmark\n";
     cout << "   8. Win At Chess Test\n";
     cout << "   9. Settings\n";
+    cout << "  10. Mate Solver Test\n";
+    cout << "  11. Solve a Mate\n";
     cout << "-----------------------------------\n";
     cout << "   0. Quit\n";
     cout << "-----------------------------------\n";
@@ -224,7 +284,11 @@ void CLI::print_messages() {
 
 void CLI::show_settings() {
     cout << "-----------------------------------\n";
-    cout << "   1. Set max thinking time (" << max_thinking_time << " sec)\n";
+    if (max_thinking_time > 0) {
+        cout << "   1. Set max thinking time (" << max_thinking_time << " sec)\n";
+    } else {
+        cout << "   1. Set max thinking time (no limit)\n";
+    }
     cout << "   2. Set max depth search (" << max_search_depth << " plies)\n";
 
     if (show_best_score) {
@@ -238,6 +302,25 @@ void CLI::show_settings() {
     } else {
         cout << "   4. Show what I'm thinking\n";
     }
+    cout << "   5. Set number of threads (" << threads << ")\n";
+    if (parallel_search == SMP_LAZY) {
+        cout << "   6. Use split points (now lazy SMP)\n";
+    } else if (parallel_search == SMP_SPLIT_POINTS) {
+        cout << "   6. Use Monte Carlo tree search (now split points)\n";
+    } else {
+        cout << "   6. Use lazy SMP (now Monte Carlo tree search)\n";
+    }
+    cout << "   7. Set a search parameter (";
+    for (search_parameter* p = parameter_list; p->name != NULL; p++) {
+        cout << (p == parameter_list ? "" : " ") << p->name << "=" << *p->value;
+    }
+    cout << ")\n";
+    if (max_nodes > 0) {
+        cout << "   8. Set max nodes (" << max_nodes << ", no time limit)\n";
+    } else {
+        cout << "   8. Set max nodes (no limit)\n";
+    }
+    cout << "   9. Set multi-PV lines (" << multi_pv << ")\n";
     cout << "-----------------------------------\n";
     cout << "   0. Back\n";
     cout << "-----------------------------------\n";
@@ -267,21 +350,21 @@ int CLI::get_user_option() {
     cin >> temp;
 
     if (temp.size() > 0 && temp[0] >= '0' && temp[0] <= '9') {
-        result = temp[0] - '0';
+        result = atoi(temp.c_str());
     }
     return result;
 }
 
 void CLI::set_max_time_from_user() {
     string temp;
-    int seconds = 0;
-    while (seconds == 0) {
+    int seconds = -1;
+    while (seconds < 0) {
         cout << "Current time: " << max_thinking_time << " sec\n";
-        cout << "Enter thinking time (sec): ";
+        cout << "Enter thinking time (sec, 0 is no limit): ";
         cin >> temp;
         seconds = atoi(temp.c_str());
-        if (seconds == 0) {
-            cerr << "The time should be greater than 0!\n";
+        if (seconds < 0) {
+            cerr << "The time should not be negative!\n";
         }
     }
     max_thinking_time = seconds;
@@ -302,6 +385,60 @@ void CLI::set_max_depth_from_user() {
     max_search_depth = depth;
 }
 
+void CLI::set_max_nodes_from_user() {
+    string temp;
+    int nodes = -1;
+    while (nodes < 0) {
+        cout << "Current max nodes: " << max_nodes << "\n";
+        cout << "Enter max nodes (0 is no limit): ";
+        cin >> temp;
+        nodes = atoi(temp.c_str());
+        if (nodes < 0) {
+            cerr << "The number of nodes should not be negative!\n";
+        }
+    }
+    max_nodes = nodes;
+}
+
+void CLI::set_multi_pv_from_user() {
+    string temp;
+    int lines = 0;
+    while (lines < 1 || lines > MAX_MULTI_PV) {
+        cout << "Current multi-PV lines: " << multi_pv << "\n";
+        cout << "Enter number of lines (1-" << MAX_MULTI_PV << "): ";
+        cin >> temp;
+        lines = atoi(temp.c_str());
+        if (lines < 1 || lines > MAX_MULTI_PV) {
+            cerr << "The number of lines should be between 1 and " << MAX_MULTI_PV << "!\n";
+        }
+    }
+    multi_pv = lines;
+}
+
+void CLI::set_parameter_from_user() {
+    string temp;
+    cout << "Enter a parameter as name=value: ";
+    cin >> temp;
+    if (!set_search_parameter(temp)) {
+        cerr << "Unknown parameter or value out of range: " << temp << "\n";
+    }
+}
+
+void CLI::set_threads_from_user() {
+    string temp;
+    int count = 0;
+    while (count < 1 || count > MAX_THREADS) {
+        cout << "Current threads: " << threads << "\n";
+        cout << "Enter number of threads (1-" << MAX_THREADS << "): ";
+        cin >> temp;
+        count = atoi(temp.c_str());
+        if (count < 1 || count > MAX_THREADS) {
+            cerr << "The number of threads should be between 1 and " << MAX_THREADS << "!\n";
+        }
+    }
+    threads = count;
+}
+
 void CLI::start_game() {
     if (loaded_game) {
         board->set_inversed(inverse_board);
@@ -348,9 +485,12 @@ void CLI::run_benchmark() {
     // old bench: "rq3rk1/4bppp/p1Rp1n2/8/4p3/1B2BP2/PP4PP/3Q1RK1 w - - 0 17"
     string fen = BENCHMARK_FEN;
     Board* board = new Board(fen);
-    Player* player = new ComputerPlayer(false);
+    ComputerPlayer* player = new ComputerPlayer(false);
     player->set_board(board);
     player->set_max_thinking_time(max_thinking_time);
+    player->set_multi_pv(multi_pv);
+    player->set_threads(threads);
+    player->set_parallel_search(parallel_search);
     //during the benchmark show the thinking it's fun...
     player->set_show_thinking(true);
 
@@ -363,10 +503,16 @@ void CLI::run_benchmark() {
     int times[3];
     int nodes[3];
     for (int i = 0; i < 3; i++) {
+#ifdef USE_HASH_TABLE
+        //every run should start with an empty table.. unless it's shared
+        if (!hash_table.is_shared()) {
+            hash_table.clear();
+        }
+#endif
         int start = get_ms();
         player->get_move();
         times[i] = get_ms() - start;
-        nodes[i] = board->checked_nodes;
+        nodes[i] = player->get_checked_nodes();
     }
     cout << "-------- Benchmark Results --------\n";
     double best_nps = 0;
@@ -380,6 +526,73 @@ void CLI::run_benchmark() {
     cout << "  Best of 3: " << (int) (best_nps) << " nodes/sec\n";
     delete player;
     delete board;
+    if (threads > 1) {
+        run_threads_benchmark();
+    }
+}
+
+/*
+ * Searches the benchmark position to a fixed depth with 1, 2, 4.. threads.
+ * The overhead is the number of extra nodes compared to one thread.
+ * The Monte Carlo tree search has no depth, so it runs for a fixed time and
+ * the speedup is the one of the nodes per second.
+ */
+void CLI::run_threads_benchmark() {
+    vector<int> counts;
+    for (int count = 1; count < threads; count *= 2) {
+        counts.push_back(count);
+    }
+    counts.push_back(threads);
+
+    string fen = BENCHMARK_FEN;
+    vector<int> times;
+    vector<int> nodes;
+    vector<int> playouts;
+    bool mcts = parallel_search == SMP_MCTS;
+    for (unsigned i = 0; i < counts.size(); i++) {
+#ifdef USE_HASH_TABLE
+        if (!hash_table.is_shared()) {
+            hash_table.clear();
+        }
+#endif
+        Board board = Board(fen);
+        ComputerPlayer* player = new ComputerPlayer(false);
+        player->set_board(&board);
+        if (mcts) {
+            player->set_max_thinking_time(MCTS_BENCHMARK_TIME);
+        } else {
+            player->set_max_thinking_time(600);
+            player->set_max_search_depth(BENCHMARK_DEPTH);
+        }
+        player->set_threads(counts[i]);
+        player->set_parallel_search(parallel_search);
+        int start = get_ms();
+        player->get_move();
+        times.push_back(get_ms() - start);
+        nodes.push_back(player->get_checked_nodes());
+        playouts.push_back(player->get_playouts());
+        delete player;
+    }
+
+    if (mcts) {
+        cout << "---- Threads (MCTS), " << MCTS_BENCHMARK_TIME << " seconds ----\n";
+        cout << "threads   time     nodes  nodes/sec  playouts  playouts/sec  speedup\n";
+        for (unsigned i = 0; i < counts.size(); i++) {
+            double speed = nodes[i] * 1000.0 / (times[i] + 1);
+            printf("%7d %6.2fs %9d %10d %9d %13d %7.2fx\n", counts[i], times[i] / 1000.0,
+                    nodes[i], (int) speed, playouts[i], (int) (playouts[i] * 1000.0 / (times[i] + 1)),
+                    speed / (nodes[0] * 1000.0 / (times[0] + 1)));
+        }
+        return;
+    }
+    cout << "---- Threads (" << (parallel_search == SMP_LAZY ? "lazy SMP" : "split points");
+    cout << "), depth " << BENCHMARK_DEPTH << " ----\n";
+    cout << "threads   time     nodes  nodes/sec  speedup  overhead\n";
+    for (unsigned i = 0; i < counts.size(); i++) {
+        printf("%7d %6.2fs %9d %10d %7.2fx %8.1f%%\n", counts[i], times[i] / 1000.0,
+                nodes[i], (int) (nodes[i] * 1000.0 / (times[i] + 1)),
+                (double) times[0] / (times[i] + 1), (nodes[i] - nodes[0]) * 100.0 / nodes[0]);
+    }
 }
 
 bool CLI::compare_found_move(string found, string should) {
@@ -417,6 +630,16 @@ void CLI::run_wac_test() {
 
     int total_tested = 0;
     int total_solved = 0;
+    double total_nodes = 0;
+    double total_quiescence_nodes = 0;
+    double total_cutoffs = 0;
+    double total_first_move_cutoffs = 0;
+    int total_time = 0;
+    int total_solution_time = 0;
+    int stopped_by_time = 0;
+    int total_overshoot = 0;
+    int max_overshoot = 0;
+    int solution_time = 0;
 
     string line = "";
     while (!file.eof()) {
@@ -437,12 +660,31 @@ void CLI::run_wac_test() {
             fen = line.substr(5, line.length() - 5);
             fens.push_back(fen);
             Board board = Board(fen);
-            Player* player = new ComputerPlayer(false);
+            ComputerPlayer* player = new ComputerPlayer(false);
             player->set_board(&board);
             player->set_max_thinking_time(max_thinking_time);
+            player->set_max_search_depth(max_search_depth);
+            player->set_max_nodes(max_nodes);
+            player->set_multi_pv(multi_pv);
             player->set_show_best_score(show_best_score);
             player->set_show_thinking(show_thinking);
+            player->set_threads(threads);
+            player->set_parallel_search(parallel_search);
+            int start = get_ms();
             move m = player->get_move();
+            total_time += get_ms() - start;
+            total_nodes += player->get_checked_nodes();
+            total_quiescence_nodes += player->get_quiescence_nodes();
+            total_cutoffs += player->get_beta_cutoffs();
+            total_first_move_cutoffs += player->get_first_move_cutoffs();
+            if (player->get_overshoot() >= 0) {
+                stopped_by_time++;
+                total_overshoot += player->get_overshoot();
+                if (player->get_overshoot() > max_overshoot) {
+                    max_overshoot = player->get_overshoot();
+                }
+            }
+            solution_time = player->get_best_move_time();
             algebraic = move_to_algebraic(m, board);
             found.push_back(algebraic);
             delete player;
@@ -455,6 +697,7 @@ void CLI::run_wac_test() {
 
             if (success) {
                 total_solved++;
+                total_solution_time += solution_time;
                 cout << "Test " << total_tested << " successful. ";
                 cout << "Found: " << algebraic << endl;
             } else {
@@ -471,10 +714,25 @@ void CLI::run_wac_test() {
     file.close();
 
     cout << "---- Test Results ----\n";
-    printf("Solved %d/%d tests (%.1f%%)\n\n",
+    printf("Solved %d/%d tests (%.1f%%)\n",
             total_solved,
             total_tested,
             (float) (total_solved) / total_tested * 100);
+    printf("Searched %s nodes in %.2f secs, ", display_nodes_count(total_nodes),
+            total_time / 1000.0);
+    printf("%s in quiescence (%.1f%%)\n", display_nodes_count(total_quiescence_nodes),
+            total_quiescence_nodes * 100 / (total_nodes + 1));
+    printf("Beta cutoffs on the first move: %.1f%%\n",
+            total_first_move_cutoffs * 100 / (total_cutoffs + 1));
+    if (total_solved > 0) {
+        printf("Average time to solution: %.3f secs\n",
+                total_solution_time / 1000.0 / total_solved);
+    }
+    if (stopped_by_time > 0) {
+        printf("Overshoot after the deadline: avg %.1f ms, max %d ms (%d searches stopped by time)\n",
+                (float) total_overshoot / stopped_by_time, max_overshoot, stopped_by_time);
+    }
+    cout << endl;
 
     cout << "---- Failed results ----\n";
 
@@ -492,3 +750,142 @@ void CLI::run_wac_test() {
     }
 }
 
+/*
+ * Runs the mate solver on the positions of the Win At Chess test. The first
+ * mate that is found is checked for a shorter one, the other positions
+ * should end without a mate.
+ */
+void CLI::run_mate_solver_test() {
+    ifstream file;
+    file.open(WAC_FILE);
+    if (!file) {
+        cerr << "Can not run Mate Solver test: Test file '" << WAC_FILE;
+        cerr << "' is missing.\n";
+        return;
+    }
+
+    int node_limit = max_nodes > 0 ? max_nodes : MATE_SOLVER_NODES;
+    MateSolver solver;
+    int total_tested = 0;
+    int total_mates = 0;
+    int total_solved = 0;
+    int total_shortest = 0;
+    int total_unknown = 0;
+    double total_nodes = 0;
+    double total_first_nodes = 0;
+    double total_proof_size = 0;
+    int total_time = 0;
+    int total_first_time = 0;
+    int result = MATE_NOT_FOUND;
+    string algebraic = "";
+
+    string line = "";
+    while (!file.eof()) {
+        getline(file, line);
+        if (line.size() < 4) {
+            continue;
+        }
+        string cmd = line.substr(0, 4);
+        if (cmd.compare("svfe") == 0) {
+            Board board = Board(line.substr(5, line.length() - 5));
+            result = solver.solve(board, MATE_SOLVER_MAX_MOVES, node_limit, true);
+            total_nodes += solver.nodes;
+            total_time += solver.time;
+            algebraic = "";
+            if (result == MATE_FOUND) {
+                algebraic = move_to_algebraic(solver.line[0], board);
+            }
+        } else if (cmd.compare("srch") == 0) {
+            string answer = line.substr(5, line.length() - 5);
+            total_tested++;
+            cout << "Test " << total_tested << ": ";
+            if (result == MATE_FOUND) {
+                total_mates++;
+                total_first_nodes += solver.first_nodes;
+                total_first_time += solver.first_time;
+                total_proof_size += solver.proof_size;
+                bool success = compare_found_move(algebraic, answer);
+                if (success) {
+                    total_solved++;
+                }
+                if (solver.shortest) {
+                    total_shortest++;
+                }
+                cout << "mate in " << solver.mate_in << (solver.shortest ? "" : " (or less)");
+                cout << " by " << algebraic;
+                if (!success) {
+                    cout << " (should be: " << answer << ")";
+                }
+                cout << ", proof " << solver.proof_size << " nodes";
+                cout << (solver.complete ? "" : " (incomplete)") << ", found after ";
+                printf("%s nodes in %.3f secs, ", display_nodes_count(solver.first_nodes),
+                        solver.first_time / 1000.0);
+            } else if (result == MATE_UNKNOWN) {
+                total_unknown++;
+                cout << "unknown, ";
+            } else {
+                cout << "no mate in " << MATE_SOLVER_MAX_MOVES << ", ";
+            }
+            printf("%s nodes in %.2f secs\n", display_nodes_count(solver.nodes),
+                    solver.time / 1000.0);
+        }
+    }
+    file.close();
+
+    cout << "---- Mate Solver Results ----\n";
+    printf("Mates found in %d/%d positions (%d with the move of the test), %d unknown\n",
+            total_mates, total_tested, total_solved, total_unknown);
+    if (total_mates > 0) {
+        printf("First proofs: %s nodes in %.2f secs, ", display_nodes_count(total_first_nodes),
+                total_first_time / 1000.0);
+        printf("%.1f nodes on average in the proof tree\n", total_proof_size / total_mates);
+        printf("Shortest mate proven in %d/%d positions\n", total_shortest, total_mates);
+    }
+    printf("Searched %s nodes in %.2f secs ", display_nodes_count(total_nodes),
+            total_time / 1000.0);
+    printf("(%.1fK nodes/sec)\n", total_nodes / (total_time + 1));
+    cout << endl;
+}
+
+/*
+ * Proves a mate in N moves of a FEN from the user or of the loaded game,
+ * within the node limit of the settings (MATE_SOLVER_NODES without it).
+ */
+void CLI::run_mate_solver() {
+    string text;
+    cout << "Enter a FEN (or \"game\" for the loaded game): ";
+    cin >> ws;
+    getline(cin, text);
+    if (text == "game" && !loaded_game) {
+        message = "There is no loaded game.";
+        return;
+    }
+    Board position = text == "game" ? Board(*board) : Board(text);
+
+    int moves = 0;
+    while (moves < 1 || moves > MATE_SOLVER_LONGEST) {
+        cout << "Mate in (1-" << MATE_SOLVER_LONGEST << "): ";
+        cin >> text;
+        moves = atoi(text.c_str());
+    }
+
+    cout << position;
+    MateSolver solver;
+    int node_limit = max_nodes > 0 ? max_nodes : MATE_SOLVER_NODES;
+    int result = solver.solve(position, moves, node_limit, true);
+    if (result == MATE_FOUND) {
+        cout << "Mate in " << solver.mate_in << (solver.shortest ? "" : " (or less)") << ":";
+        Board temp_board = Board(position);
+        for (unsigned i = 0; i < solver.line.size(); i++) {
+            cout << " " << move_to_algebraic(solver.line[i], temp_board);
+            temp_board.fake_move(solver.line[i]);
+        }
+        cout << "\nProof " << solver.proof_size << " nodes";
+        cout << (solver.complete ? "" : " (incomplete, out of nodes)") << "\n";
+    } else if (result == MATE_UNKNOWN) {
+        cout << "Unknown, out of nodes\n";
+    } else {
+        cout << "No mate in " << moves << "\n";
+    }
+    printf("%s nodes in %.2f secs\n", display_nodes_count(solver.nodes), solver.time / 1000.0);
+}
@@ -22,6 +22,7 @@
 #include "../model/MoveGenerator.h"
 #include "../player/ComputerPlayer.h"
 #include "../player/HumanPlayer.h"
+#include "../player/MateSolver.h"
 #include "../common/utils.h"
 #include "PGN.h"
 
@@ -38,6 +39,8 @@ class Board;
 #define SHOW_HELP       6
 #define BENCHMARK       7
 #define WAC             8
+#define MATE_SOLVER    10
+#define SOLVE_MATE     11
 
 #define SETTINGS        9
 
@@ -46,6 +49,11 @@ class Board;
 #define SET_MAX_DEPTH        2
 #define SET_SHOW_BEST_SCORE  3
 #define SET_SHOW_THINKING    4
+#define SET_THREADS          5
+#define SET_PARALLEL_SEARCH  6
+#define SET_SEARCH_PARAMETER 7
+#define SET_MAX_NODES        8
+#define SET_MULTI_PV         9
 
 //loading defines
 #define LOAD_NEW_GAME        1
@@ -58,6 +66,13 @@ public:
     CLI();
     virtual ~CLI();
     void start(int option=-1);
+    void set_threads(int count);
+    void set_parallel_search(int algorithm);
+    //0 is no limit
+    void set_max_thinking_time(int seconds);
+    void set_max_search_depth(int depth);
+    void set_max_nodes(int nodes);
+    void set_multi_pv(int lines);
 
 private:
     void init();
@@ -73,6 +88,10 @@ private:
     //time is in seconds
     int max_thinking_time;
     int max_search_depth;
+    int max_nodes;
+    int multi_pv;
+    int threads;
+    int parallel_search;
     bool show_best_score;
     bool show_thinking;
     bool loaded_game;
@@ -91,13 +110,20 @@ private:
     void apply_load(int option);
     void set_max_time_from_user();
     void set_max_depth_from_user();
+    void set_max_nodes_from_user();
+    void set_multi_pv_from_user();
+    void set_threads_from_user();
+    void set_parameter_from_user();
     int get_user_option();
     void init_game(int game_type);
     void start_game();
     void end_game();
     void read_fen();
     void run_benchmark();
+    void run_threads_benchmark();
     void run_wac_test();
+    void run_mate_solver_test();
+    void run_mate_solver();
     std::string get_line();
 
     bool compare_found_move(string found, string should);
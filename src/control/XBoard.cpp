@@ -24,7 +24,10 @@ using std::ifstream;
 using std::ios;
 using std::endl;
 
-XBoard::XBoard() : game_started(false), version(0), show_thinking(false) {
+XBoard::XBoard() : game_started(false), version(0), show_thinking(false),
+ponder(false), analyzing(false), thinking(false), thinking_ponder_hit(false), abort_move(false), threads(1), parallel_search(SMP_LAZY), level_moves(0), level_base(0),
+level_increment(0), max_search_depth(MAX_SEARCH_DEPTH),
+max_thinking_time(DEFAULT_THINKING_TIME), nps(0), max_nodes(0), multi_pv(1) {
     cout.setf(ios::unitbuf);
     cerr.setf(ios::unitbuf);
 }
@@ -33,15 +36,56 @@ XBoard::~XBoard() {
     end_game();
 }
 
+void XBoard::set_threads(int count) {
+    threads = count < 1 ? 1 : (count > MAX_THREADS ? MAX_THREADS : count);
+    if (game_started) {
+        player->set_threads(threads);
+        player->set_parallel_search(parallel_search);
+    }
+}
+
+void XBoard::set_parallel_search(int algorithm) {
+    parallel_search = algorithm;
+    if (game_started) {
+        player->set_parallel_search(parallel_search);
+    }
+}
+
+void XBoard::set_max_search_depth(int depth) {
+    max_search_depth = depth > 0 ? depth : MAX_SEARCH_DEPTH;
+    apply_limits();
+}
+
+void XBoard::set_max_thinking_time(int seconds) {
+    max_thinking_time = seconds;
+    apply_limits();
+}
+
+void XBoard::set_max_nodes(int nodes) {
+    max_nodes = nodes;
+    apply_limits();
+}
+
+void XBoard::set_multi_pv(int lines) {
+    multi_pv = lines;
+    apply_limits();
+}
+
+void XBoard::apply_limits() {
+    if (game_started) {
+        player->set_max_search_depth(max_search_depth);
+        player->set_max_thinking_time(max_thinking_time);
+        player->set_nps(nps);
+        player->set_max_nodes(max_nodes);
+        player->set_multi_pv(multi_pv);
+    }
+}
+
 bool XBoard::start() {
     cout << "# " << PROJECT_NAME << " " << VERSION << ", (c) 2009-2010\n";
     cout << "# The default mode is using xboard commands for graphical user interface.\n";
-#ifndef WIN32
     cout << "#    Download and run XBoard using this command:\n";
     cout << "#    xboard -fcp \"./chess-at-nite\" -fd \"/path/to/chess-at-nite/bin/\"\n";
-#else
-    cout << "#    Download and run WinBoard by providing \"chess-at-nite.exe\" as an engine.\n";
-#endif
     cout << "# If you want to play chess using the command line interface type \"cli\".\n";
 
     string line = "";
@@ -51,17 +95,100 @@ bool XBoard::start() {
     while (command != XB_QUIT && command != ABORT) {
         if (getline(cin, line)) {
             options.clear();
+            //a move is parsed on the board, the search might still play ours on it
+            if (thinking && line.compare(0, 8, "usermove") == 0) {
+                if (analyzing) {
+                    stop_thinking();
+                } else {
+                    wait_for_thinking();
+                }
+            }
             command = xboard_command(line, options);
+            //while we are thinking only a few commands are answered at once,
+            //the others stop the search (always in the analysis) or wait for
+            //its move
+            if (thinking && command != XB_MOVE_NOW && command != XB_PING && command != XB_TIME
+                    && command != XB_OTIM && command != XB_POST && command != XB_NOPOST
+                    && command != XB_HARD && command != XB_EASY && command != XB_XBOARD
+                    && command != XB_ACCEPTED && command != XB_RANDOM && command != XB_COMPUTER
+                    && command != XB_STATUS) {
+                if (analyzing || command == XB_FORCE || command == XB_RESULT || command == XB_NEW
+                        || command == XB_SETBOARD || command == XB_UNDO || command == XB_REMOVE
+                        || command == XB_QUIT || command == ABORT) {
+                    stop_thinking();
+                } else {
+                    wait_for_thinking();
+                }
+            }
+            //the ponder search runs on until the opponent moves, only the
+            //commands that don't touch the game can come in between
+            if (game_started && player->is_pondering() && command != XB_USERMOVE
+                    && command != XB_TIME && command != XB_OTIM && command != XB_PING
+                    && command != XB_POST && command != XB_NOPOST && command != XB_HARD
+                    && command != XB_MOVE_NOW && command != XB_ILLEGAL_MOVE) {
+                player->stop_pondering();
+            }
             switch (command) {
                 case XB_XBOARD:
                 case XB_ACCEPTED:
                 case XB_RANDOM:
-                case XB_TIME:
-                case XB_OTIM:
-                case XB_HARD:
                 case XB_COMPUTER:
-                case XB_LEVEL:
+                    break;
                 case XB_MOVE_NOW:
+                    if (thinking && !analyzing) {
+                        player->move_now();
+                    }
+                    break;
+                case XB_ANALYZE:
+                    analyzing = true;
+                    break;
+                case XB_EXIT:
+                    analyzing = false;
+                    if (game_started) {
+                        player->set_analyze(false);
+                    }
+                    break;
+                case XB_STATUS:
+                    if (thinking && analyzing) {
+                        player->print_status();
+                    }
+                    break;
+                case XB_HARD:
+                    ponder = true;
+                    break;
+                case XB_EASY:
+                    ponder = false;
+                    break;
+                case XB_LEVEL:
+                    set_level(options);
+                    break;
+                case XB_SD:
+                    set_max_search_depth(atoi(options[0].c_str()));
+                    break;
+                case XB_ST:
+                    //a fixed time per move instead of the clock
+                    if (atoi(options[0].c_str()) > 0) {
+                        level_moves = level_base = level_increment = 0;
+                        if (game_started) {
+                            player->set_level(0, 0, 0);
+                        }
+                        set_max_thinking_time(atoi(options[0].c_str()));
+                    }
+                    break;
+                case XB_NPS:
+                    nps = atoi(options[0].c_str());
+                    apply_limits();
+                    break;
+                case XB_TIME:
+                    //centiseconds
+                    if (game_started) {
+                        player->set_time(atoi(options[0].c_str()) * 10);
+                    }
+                    break;
+                case XB_OTIM:
+                    if (game_started) {
+                        player->set_opponent_time(atoi(options[0].c_str()) * 10);
+                    }
                     break;
                 case XB_NEW:
                     new_game();
@@ -72,13 +199,27 @@ bool XBoard::start() {
                         fen.append(" ");
                         fen.append(options[index]);
                     }
-                    new_game(fen);
+                    if (analyzing && game_started) {
+                        //keep the player, it knows the position already
+                        delete board;
+                        board = new Board(fen);
+                        player->set_board(board);
+                    } else {
+                        new_game(fen);
+                    }
                     break;
                 case XB_RESULT:
                     end_game();
                     break;
                 case XB_PROTOVER:
                     version = atoi(options[0].c_str());
+                    //the tunable search parameters
+                    for (search_parameter* p = parameter_list; p->name != NULL; p++) {
+                        cout << "feature option=\"" << p->name << " -spin " << *p->value;
+                        cout << " " << p->min << " " << p->max << "\"" << endl;
+                    }
+                    cout << "feature option=\"MultiPV -spin " << multi_pv;
+                    cout << " 1 " << MAX_MULTI_PV << "\"" << endl;
                     //name
                     cout << "feature myname=\"" << PROJECT_NAME;
                     cout << " " << VERSION << "\" ";
@@ -88,19 +229,22 @@ bool XBoard::start() {
                     cout << " san=1 "; //use algebraic notations for moves
                     cout << " setboard=1 "; //setting the board using FEN
                     cout << " ping=1 ";
+                    cout << " smp=1 "; //number of threads with "cores"
+                    cout << " time=1 "; //our clock with "time" and "otim"
+                    cout << " nps=1 "; //the clock counts nodes with "nps"
+                    cout << " analyze=1 ";
 
                     //features off
-                    cout << " time=0 ";
                     cout << " sigint=0 ";
                     cout << " sigterm=0 ";
                     cout << " colors=0 ";
                     cout << " draw=0 ";
-                    cout << " analyze=0 ";
                     cout << " ics=0 ";
                     cout << " done=1" << endl;
                     break;
                 case XB_PING:
-                    cout << "pong " << options[0] << endl;
+                    //one write, the search might be writing its thinking
+                    cout << "pong " + options[0] + "\n";
                     break;
                 case XB_POST:
                     show_thinking = true;
@@ -108,6 +252,16 @@ bool XBoard::start() {
                 case XB_NOPOST:
                     show_thinking = false;
                     break;
+                case XB_CORES:
+                    set_threads(atoi(options[0].c_str()));
+                    break;
+                case XB_OPTION:
+                    if (options[0].compare(0, 8, "MultiPV=") == 0) {
+                        set_multi_pv(atoi(options[0].substr(8).c_str()));
+                    } else {
+                        set_search_parameter(options[0]);
+                    }
+                    break;
                 case XB_USERMOVE:
                     xboard_moved();
                     break;
@@ -142,6 +296,10 @@ bool XBoard::start() {
                 default:
                     cerr << "#not handled: " << command << ": " << line << endl;
             }
+            //the analysis goes on with the new position
+            if (analyzing && !thinking && command != XB_QUIT && command != ABORT) {
+                start_analysis();
+            }
         }
     }
 
@@ -189,19 +347,46 @@ int XBoard::xboard_command(const string& line, vector<string>& args) {
         if (args[0] == "random") {
             return XB_RANDOM;
         }
-        if (args[0] == "level") {
+        if (args[0] == "level" && args.size() > 3) {
+            args.erase(args.begin());
             return XB_LEVEL;
         }
+        if (args[0] == "sd" && args.size() > 1) {
+            args.erase(args.begin());
+            return XB_SD;
+        }
+        if (args[0] == "st" && args.size() > 1) {
+            args.erase(args.begin());
+            return XB_ST;
+        }
+        if (args[0] == "nps" && args.size() > 1) {
+            args.erase(args.begin());
+            return XB_NPS;
+        }
         if (args[0] == "hard") {
             return XB_HARD;
         }
+        if (args[0] == "easy") {
+            return XB_EASY;
+        }
+        if (args[0] == "analyze") {
+            return XB_ANALYZE;
+        }
+        if (args[0] == "exit") {
+            return XB_EXIT;
+        }
+        if (args[0] == ".") {
+            return XB_STATUS;
+        }
         if (args[0] == "computer") {
             return XB_COMPUTER;
         }
-        if (args[0] == "time") {
+        if (args[0] == "time" && args.size() > 1) {
+            args.erase(args.begin());
             return XB_TIME;
         }
-        if (args[0] == "otim") {
+        if (args[0] == "otim" && args.size() > 1) {
+            args.erase(args.begin());
             return XB_OTIM;
         }
         if (args[0] == "post") {
@@ -210,6 +395,14 @@ int XBoard::xboard_command(const string& line, vector<string>& args) {
         if (args[0] == "nopost") {
             return XB_NOPOST;
         }
+        if (args[0] == "cores" && args.size() > 1) {
+            args.erase(args.begin());
+            return XB_CORES;
+        }
+        if (args[0] == "option" && args.size() > 1) {
+            args.erase(args.begin());
+            return XB_OPTION;
+        }
         if (args[0] == "ping") {
             args.erase(args.begin());
             return XB_PING;
@@ -240,11 +433,36 @@ void XBoard::new_game(const string& fen) {
     player = new ComputerPlayer();
     player->set_xboard(true);
     player->set_board(board);
+    player->set_threads(threads);
+    player->set_parallel_search(parallel_search);
+    //"level 0 0 5" has only an increment
+    if (level_base > 0 || level_increment > 0) {
+        player->set_level(level_moves, level_base, level_increment);
+    }
     game_started = true;
+    apply_limits();
     force_mode = false;
 }
 
+/*
+ * level MOVES BASE INCREMENT: BASE is in minutes or "minutes:seconds",
+ * INCREMENT in seconds.
+ */
+void XBoard::set_level(const vector<string>& args) {
+    level_moves = atoi(args[0].c_str());
+    level_base = atoi(args[1].c_str()) * 60000;
+    size_t colon = args[1].find(':');
+    if (colon != string::npos) {
+        level_base += atoi(args[1].substr(colon + 1).c_str()) * 1000;
+    }
+    level_increment = (int) (atof(args[2].c_str()) * 1000);
+    if (game_started) {
+        player->set_level(level_moves, level_base, level_increment);
+    }
+}
+
 void XBoard::end_game() {
+    stop_thinking();
     if (game_started) {
         delete board;
         delete player;
@@ -254,33 +472,99 @@ void XBoard::end_game() {
 
 void XBoard::xboard_moved() {
     int status;
+    bool ponder_hit = false;
+    if (player->is_pondering()) {
+        ponder_hit = is_same_move(xboard_move, player->get_ponder_move());
+        if (!ponder_hit) {
+            player->stop_pondering();
+        }
+    }
     board->add_pgn(move_to_algebraic(xboard_move, *board));
     board->play_move(xboard_move);
 
     status = update_board_status(board);
     board -> set_status(status);
 
-    if (pgn_game_result(status) != "*") {
+    if (ponder_hit) {
+        //the position was searched already, it can't be the end of the game
+        start_thinking(true);
+    } else if (pgn_game_result(status) != "*") {
         cout << pgn_game_result(status);
         cout << " {" << pgn_game_result_comment(status) << "}" << endl;
-    } else if (!force_mode) {
+    } else if (!force_mode && !analyzing) {
         computer_move();
     }
 }
 
 void XBoard::computer_move() {
-    int status;
-    move m;
     player->set_show_thinking(show_thinking);
-    m = player->get_move();
+    start_thinking(false);
+}
+
+void* XBoard::run_thinking(void* data) {
+    XBoard* xboard = (XBoard*) data;
+    move m = xboard->thinking_ponder_hit ? xboard->player->ponder_hit() : xboard->player->get_move();
+    if (!xboard->abort_move && !xboard->analyzing) {
+        xboard->send_move(m);
+    }
+    return NULL;
+}
+
+void XBoard::start_thinking(bool ponder_hit) {
+    thinking_ponder_hit = ponder_hit;
+    abort_move = false;
+    thinking = true;
+    pthread_create(&search_thread, NULL, run_thinking, this);
+}
+
+/*
+ * Searches the position until the next command that changes it, the player
+ * (with its transposition table and move ordering) is the same all the time.
+ */
+void XBoard::start_analysis() {
+    if (!game_started) {
+        return;
+    }
+    int status = update_board_status(board);
+    if (pgn_game_result(status) != "*") {
+        return;
+    }
+    player->set_analyze(true);
+    player->set_show_thinking(true);
+    start_thinking(false);
+}
+
+void XBoard::wait_for_thinking() {
+    if (thinking) {
+        pthread_join(search_thread, NULL);
+        thinking = false;
+    }
+}
+
+void XBoard::stop_thinking() {
+    if (thinking) {
+        abort_move = true;
+        player->move_now();
+        wait_for_thinking();
+    }
+}
+
+/*
+ * Called on the thread of the search, the input thread doesn't touch the
+ * board until the search is joined. A few commands don't wait for it, they
+ * can stop the ponder search while it starts: the player locks both.
+ */
+void XBoard::send_move(move m) {
+    int status;
     //do not change the order.. otherwise the algebraic notation will be wrong
-    cout << "move " << move_to_algebraic(m, *board) << endl;
+    cout << "move " + move_to_algebraic(m, *board) + "\n";
     board->play_move(m);
 
     status = update_board_status(board);
     if (pgn_game_result(status) != "*") {
-        cout << pgn_game_result(status);
-        cout << " {" << pgn_game_result_comment(status) << "}" << endl;
+        cout << pgn_game_result(status) + " {" + pgn_game_result_comment(status) + "}\n";
+    } else if (ponder) {
+        player->start_pondering();
     }
 }
 
@@ -18,6 +18,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <pthread.h>
 #include "../common/utils.h"
 #include "../model/Board.h"
 #include "../player/ComputerPlayer.h"
@@ -34,6 +35,10 @@
 #define XB_HARD       33
 #define XB_COMPUTER   34
 #define XB_SETBOARD   35
+#define XB_SD         36
+#define XB_ST         37
+#define XB_NPS        38
+#define XB_EASY       39
 
 
 #define XB_USERMOVE   40
@@ -47,6 +52,11 @@
 #define XB_OTIM       71
 #define XB_POST       72
 #define XB_NOPOST     73
+#define XB_CORES      74
+#define XB_OPTION     75
+#define XB_ANALYZE    76
+#define XB_EXIT       77
+#define XB_STATUS     78
 
 #define XB_ERROR             -1
 #define XB_UNKNOWN_COMMAND   -2
@@ -63,6 +73,13 @@ public:
     XBoard();
     virtual ~XBoard();
     bool start();
+    void set_threads(int count);
+    void set_parallel_search(int algorithm);
+    //limits of the search, like "sd" and "st" (0 is no limit)
+    void set_max_search_depth(int depth);
+    void set_max_thinking_time(int seconds);
+    void set_max_nodes(int nodes);
+    void set_multi_pv(int lines);
 private:
     bool game_started;
     int version;
@@ -72,13 +89,47 @@ private:
 
     bool show_thinking;
     bool force_mode;
+    //"hard": think on the time of the opponent
+    bool ponder;
+    //"analyze" until "exit"
+    bool analyzing;
+    //the search runs on its own thread, so the commands are read meanwhile
+    pthread_t search_thread;
+    bool thinking;
+    //the search continues a ponder hit
+    bool thinking_ponder_hit;
+    //the move of the search is not sent (e.g. after "force")
+    volatile bool abort_move;
+    int threads;
+    int parallel_search;
+    //time control from "level", in ms
+    int level_moves;
+    int level_base;
+    int level_increment;
+    //"sd", "st" (in seconds) and "nps", and a node limit from the command line
+    int max_search_depth;
+    int max_thinking_time;
+    int nps;
+    int max_nodes;
+    //option "MultiPV"
+    int multi_pv;
     bool legal_move(const string& input);
 
     int xboard_command(const string& line, vector<string>& args);
     void new_game(const string& fen=DEFAULT_FEN);
     void end_game();
+    void set_level(const vector<string>& args);
+    void apply_limits();
     void xboard_moved();
     void computer_move();
+    void send_move(move m);
+    void start_thinking(bool ponder_hit);
+    void start_analysis();
+    //waits for the move of the search
+    void wait_for_thinking();
+    //stops the search and throws away its move
+    void stop_thinking();
+    static void* run_thinking(void* data);
     void remove_move();
     void undo_move();
 };
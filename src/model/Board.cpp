@@ -24,6 +24,22 @@ using std::ifstream;
 using std::ios;
 using std::endl;
 
+/*
+ * The random keys are the same for all the boards (and all the engines, since
+ * hash_rand() has a fixed seed), so the positions can be compared by hash and
+ * shared in the transposition table.
+ */
+static bool hash_initialized = false;
+static u64 hash_pieces[PIECES][COLORS][BOARD_SIZE];
+static u64 hash_casteling_white[CASTLE_LONG + CASTLE_SHORT + 1]; //to use it as index
+static u64 hash_casteling_black[CASTLE_LONG + CASTLE_SHORT + 1]; //to use it as index
+static u64 hash_en_passant[BOARD_SIZE];
+static u64 hash_side;
+
+static inline u64 hash_piece(int piece, int square) {
+    return hash_pieces[abs(piece) - 1][piece > EMPTY ? 0 : 1][square];
+}
+
 Board::Board(bool inversed) : inversed(inversed) {
     inititalize();
 }
@@ -44,25 +60,17 @@ Board::Board(const Board& b) {
 
     black_king = b.black_king;
     white_king = b.white_king;
+    pieces = b.pieces;
     black_castle = b.black_castle;
     white_castle = b.white_castle;
 
     en_passant = b.en_passant;
     fifty_moves = b.fifty_moves;
     full_moves = b.full_moves;
-    stop_time = b.stop_time;
     to_move = b.to_move;
-    checked_nodes = b.checked_nodes;
-    time_exit = b.time_exit;
     inversed = b.inversed;
     status = b.status;
     current_hash = b.current_hash;
-
-    objcpy(hash_casteling_black, b.hash_casteling_black);
-    objcpy(hash_casteling_white, b.hash_casteling_white);
-    objcpy(hash_en_passant, b.hash_en_passant);
-    objcpy(hash_pieces, b.hash_pieces);
-    objcpy(hash_promotion, b.hash_promotion);
 }
 
 Board::Board(const string& fen, bool inversed) : inversed(inversed) {
@@ -114,6 +122,8 @@ Board::Board(const string& fen, bool inversed) : inversed(inversed) {
 
     // the sixth token is for the number of full moves
     full_moves = atoi(tokens[5].c_str());
+
+    current_hash = generate_hash();
 }
 
 Board::~Board() {
@@ -130,15 +140,13 @@ void Board::inititalize() {
     black_castle = CASTLE_LONG | CASTLE_SHORT;
     fifty_moves = 0;
     full_moves = 1;
+    pieces = 0;
 
     history.clear();
     pgn.clear();
     white_captures.clear();
     black_captures.clear();
 
-    time_exit = false;
-    checked_nodes = 0;
-
     initialize_hash();
 }
 
@@ -166,6 +174,9 @@ void Board::parse_fen(string& fen) {
         for (unsigned int file = 0; file < ranks[rank].size(); file++) {
             square = (7 - rank) * NEXT_RANK + file * NEXT_FILE;
             board[square] = lookup_piece(ranks[rank][file]);
+            if (board[square] != EMPTY) {
+                pieces++;
+            }
             switch (board[square]) {
                 case WHITE_KING:
                     white_king = square;
@@ -256,12 +267,18 @@ void Board::fake_move(move m) {
     last_item.black_castle = black_castle;
     last_item.en_passant = en_passant;
     last_item.fifty_moves = fifty_moves;
+    last_item.previous_hash = current_hash;
+    //the old castling and en passant flags are not valid anymore
+    current_hash ^= hash_flags();
     en_passant = NO_SQUARE;
 
     fifty_moves++;
     if (to_move == BLACK) {
         full_moves++;
     }
+    if (m.content != EMPTY) {
+        pieces--;
+    }
 
     switch (m.special) {
         case MOVE_ORDINARY:
@@ -360,8 +377,8 @@ void Board::fake_move(move m) {
     }
     to_move = OPPONENT(to_move);
 
-    ply++;
     update_hash(m);
+    current_hash ^= hash_flags() ^ hash_side;
     last_item.hash = current_hash;
     history.push_back(last_item);
 }
@@ -387,9 +404,12 @@ move Board::unfake_move() {
     black_castle = last_item.black_castle;
     en_passant = last_item.en_passant;
     fifty_moves = last_item.fifty_moves;
-    update_hash(last_item.m);
+    current_hash = last_item.previous_hash;
 
     move m = last_item.m;
+    if (m.content != EMPTY) {
+        pieces++;
+    }
     switch (m.special) {
         case MOVE_ORDINARY:
         case MOVE_PROMOTION:
@@ -447,10 +467,41 @@ move Board::unfake_move() {
     if (to_move == BLACK) {
         full_moves--;
     }
-    ply--;
     return last_item.m;
 }
 
+/*
+ * The side to move just passes. The null move is stored in the history with an
+ * EMPTY moved piece, and the fifty moves counter starts again so repetitions
+ * are never searched across it.
+ */
+void Board::make_null_move() {
+    history_item last_item;
+    last_item.m.move = 0;
+    last_item.white_castle = white_castle;
+    last_item.black_castle = black_castle;
+    last_item.en_passant = en_passant;
+    last_item.fifty_moves = fifty_moves;
+    last_item.previous_hash = current_hash;
+
+    current_hash ^= hash_flags();
+    en_passant = NO_SQUARE;
+    fifty_moves = 0;
+    to_move = OPPONENT(to_move);
+    current_hash ^= hash_flags() ^ hash_side;
+    last_item.hash = current_hash;
+    history.push_back(last_item);
+}
+
+void Board::unmake_null_move() {
+    history_item last_item = history.back();
+    history.pop_back();
+    en_passant = last_item.en_passant;
+    fifty_moves = last_item.fifty_moves;
+    current_hash = last_item.previous_hash;
+    to_move = OPPONENT(to_move);
+}
+
 /*
  * This is an expensive function! Should be called only when the actual move is
  * going to be played for the game.. if you want to use something for finding
@@ -499,134 +550,102 @@ void Board::add_pgn(string algebraic) {
 }
 
 void Board::initialize_hash() {
-    // pieces
-    for (int piece = 0; piece < PIECES; piece++) {
-        for (int color = 0; color < COLORS; color++) {
-            for (int square = 0; square < BOARD_SIZE; square++) {
-                hash_pieces[piece][color][square] = hash_rand();
+    if (!hash_initialized) {
+        // pieces
+        for (int piece = 0; piece < PIECES; piece++) {
+            for (int color = 0; color < COLORS; color++) {
+                for (int square = 0; square < BOARD_SIZE; square++) {
+                    hash_pieces[piece][color][square] = hash_rand();
+                }
             }
         }
-    }
-    // en passant
-    for (int square = 0; square < BOARD_SIZE; square++) {
-        hash_en_passant[square] = hash_rand();
-    }
-    // castling options
-    for (int i = 0; i <= CASTLE_LONG; i++) {
-        hash_casteling_black[i] = hash_rand();
-        hash_casteling_white[i] = hash_rand();
-    }
-
-    // promotion pieces
-    for (int piece = 0; piece < PIECES; piece++) {
-        hash_promotion[piece] = hash_rand();
+        // en passant
+        for (int square = 0; square < BOARD_SIZE; square++) {
+            hash_en_passant[square] = hash_rand();
+        }
+        // castling options
+        for (int i = 0; i <= (CASTLE_LONG | CASTLE_SHORT); i++) {
+            hash_casteling_black[i] = hash_rand();
+            hash_casteling_white[i] = hash_rand();
+        }
+        // side
+        hash_side = hash_rand();
+        hash_initialized = true;
     }
 
-    // side
-    hash_side = hash_rand();
-
     // generate current hash for start positions
     current_hash = generate_hash();
 }
 
-int Board::get_hash() {
+u64 Board::get_hash() {
     return current_hash;
 }
 
-void Board::update_hash(move m) {
-    int key = current_hash;
-    int color = m.moved_piece > EMPTY ? 0 : 1;
-    int piece = abs(m.moved_piece) - 1;
-    key ^= hash_pieces[piece][color][m.pos_old];
-    key ^= hash_pieces[piece][color][m.pos_new];
-
-    if (m.content != 0) {
-        key ^= hash_pieces[abs(m.content) - 1][color][m.pos_new];
+/*
+ * Part of the hash for the castling and en passant flags
+ */
+u64 Board::hash_flags() {
+    u64 key = hash_casteling_white[white_castle] ^ hash_casteling_black[black_castle];
+    if (en_passant != NO_SQUARE) {
+        key ^= hash_en_passant[en_passant];
     }
+    return key;
+}
+
+/*
+ * Updates only the pieces of the move, the flags and the side are done by the
+ * fake_move().
+ */
+void Board::update_hash(move m) {
+    u64 key = current_hash;
+    int rook = m.moved_piece > EMPTY ? WHITE_ROOK : BLACK_ROOK;
+    key ^= hash_piece(m.moved_piece, m.pos_old);
 
     switch (m.special) {
-        case MOVE_CASTLE_LONG:
-            if (color == WHITE) {
-                key ^= hash_casteling_white[CASTLE_LONG];
-            } else {
-                key ^= hash_casteling_black[CASTLE_LONG];
+        case MOVE_ORDINARY:
+            key ^= hash_piece(m.moved_piece, m.pos_new);
+            if (m.content != EMPTY) {
+                key ^= hash_piece(m.content, m.pos_new);
             }
             break;
-        case MOVE_CASTLE_SHORT:
-            if (color == WHITE) {
-                key ^= hash_casteling_white[CASTLE_SHORT];
-            } else {
-                key ^= hash_casteling_black[CASTLE_SHORT];
+        case MOVE_PROMOTION:
+            key ^= hash_piece(m.promoted, m.pos_new);
+            if (m.content != EMPTY) {
+                key ^= hash_piece(m.content, m.pos_new);
             }
             break;
         case MOVE_EN_PASSANT:
-            key ^= hash_en_passant[m.pos_new - m.moved_piece * NEXT_RANK];
+            key ^= hash_piece(m.moved_piece, m.pos_new);
+            key ^= hash_piece(m.content, m.pos_new - m.moved_piece * NEXT_RANK);
+            break;
+        case MOVE_CASTLE_SHORT:
+            key ^= hash_piece(m.moved_piece, m.pos_new);
+            key ^= hash_piece(rook, m.pos_old + CASTLING_SHORT_DIST_ROOK * NEXT_FILE);
+            key ^= hash_piece(rook, m.pos_old + NEXT_FILE);
+            break;
+        case MOVE_CASTLE_LONG:
+            key ^= hash_piece(m.moved_piece, m.pos_new);
+            key ^= hash_piece(rook, m.pos_old - CASTLING_LONG_DIST_ROOK * NEXT_FILE);
+            key ^= hash_piece(rook, m.pos_old - NEXT_FILE);
             break;
-        case MOVE_PROMOTION:
-            key ^= hash_promotion[abs(m.promoted) - 1];
     }
     current_hash = key;
 }
 
-int Board::generate_hash() {
-    int key = 0;
+u64 Board::generate_hash() {
+    u64 key = 0;
     for (int square = 0; square < BOARD_SIZE; square++) {
-        int piece = board[square];
-        if (piece > EMPTY) {
-            key ^= hash_pieces[piece - 1][0][square];
-        } else if (piece < EMPTY) {
-            key ^= hash_pieces[-piece - 1][1][square];
+        if (!(square & 0x88) && board[square] != EMPTY) {
+            key ^= hash_piece(board[square], square);
         }
     }
-    key ^= hash_casteling_white[white_castle];
-    key ^= hash_casteling_black[black_castle];
+    key ^= hash_flags();
     if (to_move == BLACK) {
         key ^= hash_side;
     }
     return key;
 }
 
-#ifdef USE_HASH_TABLE
-
-htype Board::hash_probe(int depth, int* alpha, int beta) {
-    htentry* entry = hash_entry(current_hash);
-    if (entry->key == current_hash) {
-        if (entry->depth >= depth) {
-            switch (entry->type) {
-                case EXACT:
-                    *alpha = entry->score;
-                    return EXACT;
-                case LOWER:
-                    if (entry->score >= beta)
-                        return LOWER;
-                    break;
-                case UPPER:
-                    if (entry->score <= *alpha)
-                        return UPPER;
-                    break;
-                case NO:
-                    return NO;
-            }
-        }
-    }
-    return NO;
-}
-
-htentry* Board::hash_entry(int key) {
-    return &ht[(unsigned) key % HT_SIZE];
-}
-
-void Board::hash_store(int depth, htype type, int score, move best) {
-    htentry* entry = hash_entry(current_hash);
-    entry->best = best;
-    entry->depth = depth;
-    entry->key = current_hash;
-    entry->score = score;
-    entry->type = type;
-    entry->wtm = to_move;
-}
-#endif // USE_HASH_TABLE
-
 ostream & operator<<(ostream& os, Board& board) {
     int square;
     unsigned int index;
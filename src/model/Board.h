@@ -55,19 +55,13 @@ public:
     //The number of full moves
     int full_moves;
 
-    //Time to stop thinking for an AI player
-    int stop_time;
-
-    //Flag to stop the search on a time exit
-    bool time_exit;
-
-    //Number of checked nodes in a current search
-    int checked_nodes;
-
     //squares where the kings are placed
     int white_king;
     int black_king;
 
+    //number of pieces on the board, kings included
+    int pieces;
+
     //captured pieces
     vector<int> white_captures;
     vector<int> black_captures;
@@ -76,11 +70,6 @@ public:
     vector<history_item> history;
     vector<string> pgn;
 
-    // current search path
-    move pv[MAX_PLY][MAX_PLY];
-    int pv_length[MAX_PLY];
-    bool follow_pv;
-    int ply;
 
     Board(bool rotated = false);
 
@@ -94,51 +83,37 @@ public:
 
     void fake_move(move m);
     move unfake_move();
+    //passes the turn to the opponent, only for the null move of the search
+    void make_null_move();
+    void unmake_null_move();
 
     void play_move(move m);
     //returns true if it was possible..
     bool undo_move();
     void add_pgn(string algebraic);
 
-    int get_hash();
+    u64 get_hash();
 
     void set_status(int status);
     int get_status();
     void set_inversed(int inversed);
     friend ostream & operator<<(ostream& os, Board& board);
 
-#ifdef USE_HASH_TABLE
-    htype hash_probe(int depth, int* alpha, int beta);
-    void hash_store(int depth, htype type, int score, move best);
-    htentry* hash_entry(int key);
-#endif
-
-
 private:
     //initialize values
     void inititalize();
     move parse_input(string& input);
 
     void initialize_hash();
-    int generate_hash();
+    u64 generate_hash();
+    u64 hash_flags();
     void update_hash(move m);
 
     bool inversed;
     int status;
 
     //Current hash of this position
-    int current_hash;
-    int hash_pieces[PIECES][COLORS][BOARD_SIZE];
-    int hash_casteling_white[CASTLE_LONG + 1]; //to use it as index
-    int hash_casteling_black[CASTLE_LONG + 1]; //to use it as index
-    int hash_en_passant[BOARD_SIZE];
-    int hash_side;
-    int hash_promotion[PIECES];
-
-#ifdef USE_HASH_TABLE
-    htentry ht[HT_SIZE];
-#endif
-
+    u64 current_hash;
 };
 
 
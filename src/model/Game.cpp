@@ -53,6 +53,8 @@ void Game::start_game() {
     } else {
         play(black_player, white_player);
     }
+    white_player->print_statistics();
+    black_player->print_statistics();
     if (write_last_game_pgn(LAST_PGN_FILE, board,
             white_player->get_name(), black_player->get_name())) {
         cout << "The game was saved in \"" << LAST_PGN_FILE << "\"\n";
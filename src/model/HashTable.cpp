@@ -0,0 +1,384 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#include "HashTable.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+using std::cerr;
+using std::endl;
+
+HashTable hash_table;
+
+//layout of the data word of a slot
+#define MOVE_BITS        0
+#define SCORE_BITS      16
+#define DEPTH_BITS      32
+#define TYPE_BITS       40
+#define GENERATION_BITS 42
+#define GENERATION_MASK 63
+#define EVAL_BITS       48
+
+//header is padded to a cache line, so the buckets are aligned too
+#define HEADER_SIZE ((sizeof (htheader) + 63) & ~((size_t) 63))
+
+//promoted pieces that fit into the 3 bits of a packed move
+static const int packed_promotions[] = {EMPTY, QUEEN, KNIGHT, ROOK, BISHOP};
+
+//squares are packed into 6 bits (0..63) instead of the 7 bits of 0x88
+#define PACK_SQUARE(s)   ((RANK(s) << 3) | FILE(s))
+#define UNPACK_SQUARE(p) ((((p) >> 3) << 4) | ((p) & 7))
+
+static unsigned pack_move(const move& m) {
+    if (m.move == 0) {
+        return 0;
+    }
+    unsigned promotion = 0;
+    if (m.special == MOVE_PROMOTION) {
+        for (unsigned i = 1; i < 5; i++) {
+            if (packed_promotions[i] == abs(m.promoted)) {
+                promotion = i;
+            }
+        }
+    }
+    //a1a1 is never a move, so a packed move is never 0
+    return PACK_SQUARE(m.pos_old) | (PACK_SQUARE(m.pos_new) << 6) | (promotion << 12);
+}
+
+static move unpack_move(unsigned packed) {
+    move m;
+    m.move = 0;
+    if (packed != 0) {
+        m.pos_old = UNPACK_SQUARE(packed & 63);
+        m.pos_new = UNPACK_SQUARE((packed >> 6) & 63);
+        m.special = MOVE_ORDINARY;
+        if ((packed >> 12) & 7) {
+            m.special = MOVE_PROMOTION;
+            m.promoted = packed_promotions[(packed >> 12) & 7];
+        }
+    }
+    return m;
+}
+
+HashTable::HashTable() : buckets(NULL), bucket_count(0), header(NULL),
+mapped_size(0), keep_shared(false), generation(0) {
+}
+
+HashTable::~HashTable() {
+    release();
+}
+
+bool HashTable::allocate(int megabytes) {
+    release();
+    u64 bytes = (u64) megabytes << 20;
+    bucket_count = 1;
+    while ((bucket_count << 1) * sizeof (htbucket) <= bytes) {
+        bucket_count <<= 1;
+    }
+    void* memory = NULL;
+    if (posix_memalign(&memory, 64, bucket_count * sizeof (htbucket)) != 0) {
+        cerr << "Not enough memory for a hash table of " << megabytes << " MB." << endl;
+        bucket_count = 0;
+        return false;
+    }
+    buckets = (htbucket*) memory;
+    clear();
+    return true;
+}
+
+bool HashTable::attach_shared(const string& name, int megabytes, bool keep) {
+    release();
+    u64 count = 1;
+    while ((count << 1) * sizeof (htbucket) <= ((u64) megabytes << 20)) {
+        count <<= 1;
+    }
+    size_t size = HEADER_SIZE + count * sizeof (htbucket);
+
+    bool creator = true;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        creator = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        cerr << "Can not open shared hash table '" << name << "'." << endl;
+        return allocate(megabytes);
+    }
+
+    if (creator) {
+        if (ftruncate(fd, size) != 0) {
+            cerr << "Can not resize shared hash table '" << name << "'." << endl;
+            close(fd);
+            shm_unlink(name.c_str());
+            return allocate(megabytes);
+        }
+    } else {
+        //the creator might still be resizing the segment.. wait for it
+        struct stat info;
+        bool resized = false;
+        for (int tries = 0; tries < 1000 && !resized; tries++) {
+            resized = fstat(fd, &info) == 0 && (size_t) info.st_size >= HEADER_SIZE;
+            if (!resized) {
+                usleep(1000);
+            }
+        }
+        if (!resized) {
+            cerr << "Shared hash table '" << name << "' was never set up." << endl;
+            close(fd);
+            return allocate(megabytes);
+        }
+        size = info.st_size;
+    }
+
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        cerr << "Can not map shared hash table '" << name << "'." << endl;
+        return allocate(megabytes);
+    }
+    header = (htheader*) memory;
+    mapped_size = size;
+
+    if (creator) {
+        //ftruncate already filled everything with zeros
+        header->magic = HT_MAGIC;
+        header->version = HT_VERSION;
+        header->buckets = count;
+        header->generation = 0;
+        __sync_synchronize();
+        header->ready = 1;
+    } else {
+        for (int tries = 0; tries < 1000 && !header->ready; tries++) {
+            usleep(1000);
+        }
+        __sync_synchronize();
+        if (!header->ready || header->magic != HT_MAGIC || header->version != HT_VERSION
+                || HEADER_SIZE + header->buckets * sizeof (htbucket) > size) {
+            cerr << "Shared hash table '" << name << "' is not compatible." << endl;
+            munmap(memory, size);
+            header = NULL;
+            mapped_size = 0;
+            return allocate(megabytes);
+        }
+        count = header->buckets;
+    }
+
+    buckets = (htbucket*) ((char*) memory + HEADER_SIZE);
+    bucket_count = count;
+    shared_name = name;
+    keep_shared = keep;
+    register_process();
+    return true;
+}
+
+void HashTable::release() {
+    if (header != NULL) {
+        bool last = unregister_process();
+        munmap(header, mapped_size);
+        if (last && !keep_shared) {
+            shm_unlink(shared_name.c_str());
+        }
+        header = NULL;
+        mapped_size = 0;
+        buckets = NULL;
+    }
+    if (buckets != NULL) {
+        free(buckets);
+        buckets = NULL;
+    }
+    bucket_count = 0;
+}
+
+void HashTable::register_process() {
+    int pid = getpid();
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < HT_MAX_PROCESSES; i++) {
+            int other = header->processes[i];
+            //on the second round reuse the places of crashed engines
+            if (round == 1 && other != 0 && kill(other, 0) != 0 && errno == ESRCH) {
+                __sync_bool_compare_and_swap(&header->processes[i], other, 0);
+            }
+            if (__sync_bool_compare_and_swap(&header->processes[i], 0, pid)) {
+                return;
+            }
+        }
+    }
+    cerr << "Too many engines on the shared hash table, the segment can be";
+    cerr << " unlinked while still in use." << endl;
+}
+
+/*
+ * Returns true if no other living engine is using the segment.
+ */
+bool HashTable::unregister_process() {
+    bool last = true;
+    int pid = getpid();
+    for (int i = 0; i < HT_MAX_PROCESSES; i++) {
+        int other = header->processes[i];
+        if (other == pid) {
+            __sync_bool_compare_and_swap(&header->processes[i], pid, 0);
+        } else if (other != 0 && !(kill(other, 0) != 0 && errno == ESRCH)) {
+            last = false;
+        }
+    }
+    return last;
+}
+
+void HashTable::clear() {
+    if (buckets != NULL) {
+        memset(buckets, 0, bucket_count * sizeof (htbucket));
+    }
+}
+
+void HashTable::new_search() {
+    if (buckets == NULL) {
+        allocate(DEFAULT_HASH_SIZE);
+    }
+    if (header != NULL) {
+        __sync_fetch_and_add(&header->generation, 1);
+    } else {
+        generation++;
+    }
+}
+
+int HashTable::current_generation() {
+    return (header != NULL ? header->generation : generation) & GENERATION_MASK;
+}
+
+bool HashTable::is_shared() {
+    return header != NULL;
+}
+
+int HashTable::size_mb() {
+    return (int) ((bucket_count * sizeof (htbucket)) >> 20);
+}
+
+bool HashTable::probe(u64 key, int ply, htentry& entry) {
+    if (buckets == NULL) {
+        return false;
+    }
+    htbucket* bucket = &buckets[key & (bucket_count - 1)];
+    for (int i = 0; i < HT_SLOTS_PER_BUCKET; i++) {
+        u64 data = bucket->slots[i].data;
+        u64 check = bucket->slots[i].check;
+        if ((check ^ data) != key) {
+            continue;
+        }
+        entry.type = (htype) ((data >> TYPE_BITS) & 3);
+        if (entry.type == NO) {
+            return false;
+        }
+        entry.best = unpack_move((data >> MOVE_BITS) & 0xFFFF);
+        entry.score = (short) ((data >> SCORE_BITS) & 0xFFFF);
+        entry.depth = (data >> DEPTH_BITS) & 0xFF;
+        entry.eval = (short) ((data >> EVAL_BITS) & 0xFFFF);
+        //mate and tablebase scores are stored relative to the node.. make them relative to the root
+        if (entry.score >= TABLEBASE_WIN_MIN) {
+            entry.score -= ply;
+        } else if (entry.score <= -TABLEBASE_WIN_MIN) {
+            entry.score += ply;
+        }
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Replaces the slot with the same key, or the one with the lowest depth where
+ * entries of older searches are worth less. An entry of the same key is kept
+ * if it's deeper, from this search, and the new one is not exact.
+ */
+void HashTable::store(u64 key, int ply, int depth, htype type, int score, move best, int eval) {
+    if (buckets == NULL) {
+        return;
+    }
+    if (score >= TABLEBASE_WIN_MIN) {
+        score += ply;
+    } else if (score <= -TABLEBASE_WIN_MIN) {
+        score -= ply;
+    }
+    int current = current_generation();
+    htbucket* bucket = &buckets[key & (bucket_count - 1)];
+    htslot* replace = NULL;
+    int lowest = 0;
+    for (int i = 0; i < HT_SLOTS_PER_BUCKET; i++) {
+        htslot* slot = &bucket->slots[i];
+        u64 data = slot->data;
+        if ((slot->check ^ data) == key) {
+            //keep the old best move and evaluation if we don't know any better
+            if (best.move == 0) {
+                best = unpack_move((data >> MOVE_BITS) & 0xFFFF);
+            }
+            if (eval == NO_EVAL) {
+                eval = (short) ((data >> EVAL_BITS) & 0xFFFF);
+            }
+            //a deeper bound of this search is worth more than a shallow one
+            //(the quiescence stores depth 0 almost everywhere).. only the move
+            //and the evaluation are refreshed then
+            if (type != EXACT && depth < (int) ((data >> DEPTH_BITS) & 0xFF)
+                    && ((data >> TYPE_BITS) & 3) != NO
+                    && (int) ((data >> GENERATION_BITS) & GENERATION_MASK) == current) {
+                data = (data & ~(((u64) 0xFFFF << MOVE_BITS) | ((u64) 0xFFFF << EVAL_BITS)))
+                        | ((u64) pack_move(best) << MOVE_BITS)
+                        | ((u64) (eval & 0xFFFF) << EVAL_BITS);
+                slot->data = data;
+                slot->check = key ^ data;
+                return;
+            }
+            replace = slot;
+            break;
+        }
+        int age = (current - (int) ((data >> GENERATION_BITS) & GENERATION_MASK)) & GENERATION_MASK;
+        int worth = (int) ((data >> DEPTH_BITS) & 0xFF) - 8 * age;
+        if (((data >> TYPE_BITS) & 3) == NO) {
+            worth = -1000;
+        }
+        if (replace == NULL || worth < lowest) {
+            replace = slot;
+            lowest = worth;
+        }
+    }
+
+    u64 data = ((u64) pack_move(best) << MOVE_BITS)
+            | ((u64) (score & 0xFFFF) << SCORE_BITS)
+            | ((u64) (depth & 0xFF) << DEPTH_BITS)
+            | ((u64) type << TYPE_BITS)
+            | ((u64) current << GENERATION_BITS)
+            | ((u64) (eval & 0xFFFF) << EVAL_BITS);
+    replace->data = data;
+    replace->check = key ^ data;
+}
+
+int HashTable::usage() {
+    if (buckets == NULL) {
+        return 0;
+    }
+    int used = 0;
+    int current = current_generation();
+    u64 samples = bucket_count < 250 ? bucket_count : 250;
+    for (u64 b = 0; b < samples; b++) {
+        for (int i = 0; i < HT_SLOTS_PER_BUCKET; i++) {
+            u64 data = buckets[b].slots[i].data;
+            if (((data >> TYPE_BITS) & 3) != NO
+                    && (int) ((data >> GENERATION_BITS) & GENERATION_MASK) == current) {
+                used++;
+            }
+        }
+    }
+    return (int) (used * 1000 / (samples * HT_SLOTS_PER_BUCKET));
+}
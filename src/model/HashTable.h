@@ -0,0 +1,131 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#ifndef HASHTABLE_H_
+#define HASHTABLE_H_
+
+#include <string>
+#include "../common/define.h"
+#include "../common/utils.h"
+
+using std::string;
+
+//bump it whenever the layout of a slot changes.. processes with a different
+//version are not allowed to attach to the same shared segment
+#define HT_VERSION           3
+#define HT_MAGIC             0x6368657373617433ULL
+#define HT_SLOTS_PER_BUCKET  4
+//how many engines can be registered on a shared segment
+#define HT_MAX_PROCESSES     64
+//static evaluation of an entry is not known
+#define NO_EVAL              -32768
+
+enum htype {
+    NO, EXACT, LOWER, UPPER
+};
+
+/*
+ * Decoded copy of a hash slot. The best move only contains the squares and
+ * the promoted piece, so it has to be matched against the generated moves
+ * before it is played on a board.
+ */
+typedef struct {
+    int score;
+    int depth;
+    htype type;
+    move best;
+    int eval;
+} htentry;
+
+/*
+ * One slot of the table. The whole entry is packed into data and the key is
+ * stored xor'ed with it, so a torn write (two engines or threads storing at
+ * the same time) simply looks like a different key and is ignored.
+ * No locks are needed to read or write a slot.
+ */
+typedef struct {
+    volatile u64 check;
+    volatile u64 data;
+} htslot;
+
+typedef struct {
+    htslot slots[HT_SLOTS_PER_BUCKET];
+} htbucket;
+
+/*
+ * Header in front of the buckets of a shared segment.
+ */
+typedef struct {
+    u64 magic;
+    int version;
+    volatile int ready;
+    u64 buckets;
+    volatile int generation;
+    //pids of all the engines using the segment, 0 if the place is free
+    volatile int processes[HT_MAX_PROCESSES];
+} htheader;
+
+/*
+ * Transposition table of the search.
+ *
+ * The table lives either in the private memory of the process or in a named
+ * POSIX shared memory segment, so several engines on the same host use the
+ * same table. The slots are identical in both cases.
+ *
+ * Lifetime of a shared segment: every engine registers its pid in the header.
+ * When the last living engine releases the table the segment is unlinked,
+ * unless it was attached with keep=true; then it stays until the next reboot
+ * (or until someone removes /dev/shm/<name>) and the next engine starts with
+ * a warm table. Dead pids (crashed engines) are ignored.
+ */
+class HashTable {
+public:
+    HashTable();
+    ~HashTable();
+
+    //size in megabytes
+    bool allocate(int megabytes);
+    bool attach_shared(const string& name, int megabytes, bool keep = false);
+    void release();
+    void clear();
+
+    //has to be called before every search, so old entries can be replaced
+    void new_search();
+
+    bool probe(u64 key, int ply, htentry& entry);
+    void store(u64 key, int ply, int depth, htype type, int score, move best,
+            int eval = NO_EVAL);
+
+    bool is_shared();
+    //how many slots are used in permill (sampled)
+    int usage();
+    int size_mb();
+
+private:
+    htbucket* buckets;
+    u64 bucket_count;
+    htheader* header;
+    size_t mapped_size;
+    string shared_name;
+    bool keep_shared;
+    int generation;
+
+    void register_process();
+    bool unregister_process();
+    int current_generation();
+};
+
+//one table for all the players of this process
+extern HashTable hash_table;
+
+#endif /* HASHTABLE_H_ */
@@ -41,6 +41,9 @@ int* DELTA_KING = DELTA_ALL;
 int DELTA_WHITE_PAWN[] = { MV_U, MV_UL, MV_UR, 0 }; // first move is moving forward! don't change
 int DELTA_BLACK_PAWN[] = { MV_D, MV_DR, MV_DL, 0 }; // first move is moving forward! don't change
 
+//values of the pieces for the static exchange evaluation
+const int exchange_values[] = { 0, PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, KING_VALUE };
+
 #define WHITE_PAWN_START_RANK  1 //Rank: 2
 #define BLACK_PAWN_START_RANK  6 //Rank: 7
 MoveGenerator::MoveGenerator(Board* new_board) :
@@ -65,7 +68,8 @@ void MoveGenerator::reset() {
 
     king_square = board->to_move == WHITE ? board->white_king : board->black_king;
     last_move_square = NO_SQUARE;
-    if (!board->history.empty()) {
+    //a null move of the search has no square
+    if (!board->history.empty() && board->history.back().m.moved_piece != EMPTY) {
         last_move_square = board->history.back().m.pos_new;
     }
 
@@ -689,6 +693,105 @@ bool MoveGenerator::has_direction(int *delta, int direction) {
     return false;
 }
 
+/*
+ * Static exchange evaluation: material won (or lost if negative) by the side
+ * making the move after all the captures on its target square.
+ * Swap list of the captures on the target square, each side captures with
+ * its least valuable piece and can stop when it's not worth it. The pieces
+ * that took part are removed from the board for the time of the evaluation,
+ * so the attackers behind them (x-rays) join in. Pins are not considered.
+ */
+int MoveGenerator::static_exchange(const move& m) {
+    int square = m.pos_new;
+    int gain[32];
+    int removed_squares[32];
+    byte removed_pieces[32];
+    int removed = 0;
+
+    gain[0] = exchange_values[abs(m.content)];
+    int on_square = abs(m.moved_piece);
+    if (m.special == MOVE_PROMOTION) {
+        gain[0] += exchange_values[abs(m.promoted)] - PAWN_VALUE;
+        on_square = abs(m.promoted);
+    }
+    removed_squares[removed] = m.pos_old;
+    removed_pieces[removed++] = board->board[m.pos_old];
+    board->board[m.pos_old] = EMPTY;
+    if (m.special == MOVE_EN_PASSANT) {
+        int pawn_square = m.pos_new - m.moved_piece * NEXT_RANK;
+        removed_squares[removed] = pawn_square;
+        removed_pieces[removed++] = board->board[pawn_square];
+        board->board[pawn_square] = EMPTY;
+    }
+
+    int color = m.moved_piece > EMPTY ? BLACK : WHITE;
+    int depth = 0;
+    while (depth < 30) {
+        int from = least_valuable_attacker(square, color);
+        if (from == NO_SQUARE) {
+            break;
+        }
+        depth++;
+        gain[depth] = exchange_values[on_square] - gain[depth - 1];
+        on_square = abs(board->board[from]);
+        removed_squares[removed] = from;
+        removed_pieces[removed++] = board->board[from];
+        board->board[from] = EMPTY;
+        color = OPPONENT(color);
+    }
+
+    while (removed > 0) {
+        removed--;
+        board->board[removed_squares[removed]] = removed_pieces[removed];
+    }
+    //every side can stand pat instead of capturing
+    for (; depth > 0; depth--) {
+        if (-gain[depth] < gain[depth - 1]) {
+            gain[depth - 1] = -gain[depth];
+        }
+    }
+    return gain[0];
+}
+
+/*
+ * Square of the least valuable piece of the color that attacks the square,
+ * NO_SQUARE if there is none.
+ */
+int MoveGenerator::least_valuable_attacker(int square, int color) {
+    //pawns attack from the rank behind
+    for (int file = -NEXT_FILE; file <= NEXT_FILE; file += 2 * NEXT_FILE) {
+        int from = square - color * NEXT_RANK + file;
+        if (!(from & 0x88) && board->board[from] * color == PAWN) {
+            return from;
+        }
+    }
+    for (int *delta = DELTA_KNIGHT; *delta; delta++) {
+        int from = square + *delta;
+        if (!(from & 0x88) && board->board[from] * color == KNIGHT) {
+            return from;
+        }
+    }
+    int best_square = NO_SQUARE;
+    int best_piece = KING + 1;
+    for (int *delta = DELTA_ALL; *delta; delta++) {
+        int distance = 1;
+        for (int from = square + *delta; !(from & 0x88); from += *delta, distance++) {
+            if (board->board[from] == EMPTY) {
+                continue;
+            }
+            int piece = board->board[from] * color;
+            //the king only attacks the next square, the pawns are done
+            if (piece > PAWN && piece < best_piece && (distance == 1 || piece != KING)
+                    && is_possible_to_attack(from, OPPOSITE(*delta))) {
+                best_square = from;
+                best_piece = piece;
+            }
+            break;
+        }
+    }
+    return best_square;
+}
+
 /*
  * Checks basically if it's possible from a square to attack to a specific direction
  * Not suitable for Knights
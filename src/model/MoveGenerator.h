@@ -25,13 +25,20 @@ using std::string;
 using std::vector;
 using std::multiset;
 
+//values of the pieces for the static exchange evaluation, by abs(piece)
+extern const int exchange_values[];
+
 class CompareCaptureMoves
 {
 public:
     bool operator () (const move& m1, const move& m2) const
     {
-       //sort them with the highest captured value first
-       return abs(m1.content) > abs(m2.content);
+       //sort them with the highest captured value first, and the least
+       //valuable attacker first (MVV/LVA)
+       if (abs(m1.content) != abs(m2.content)) {
+           return abs(m1.content) > abs(m2.content);
+       }
+       return abs(m1.moved_piece) < abs(m2.moved_piece);
     }
 };
 
@@ -58,6 +65,10 @@ public:
     //simple version!
     bool check_for_check_simple();
 
+    //static exchange evaluation: the material won (or lost if negative) by
+    //the move after all the captures on its target square
+    int static_exchange(const move& m);
+
 private:
     Board* board;
     vector<move> all_moves;
@@ -109,6 +120,7 @@ private:
     int check_for_check();
 
 
+    int least_valuable_attacker(int square, int color);
     bool is_possible_to_attack(int from_square, int direction);
     bool has_direction(int *delta, int direction);
     void sort_moves();
@@ -0,0 +1,676 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#include "Tablebase.h"
+#include "MoveGenerator.h"
+#include <fstream>
+
+using std::cerr;
+using std::endl;
+using std::ifstream;
+using std::ofstream;
+using std::ios;
+
+Tablebase tablebases;
+
+static const tbinfo table_info[TB_TABLES] = {
+    {"KQK", 3, {QUEEN, EMPTY}, 10 * SQUARES * SQUARES},
+    {"KRK", 3, {ROOK, EMPTY}, 10 * SQUARES * SQUARES},
+    {"KBNK", 4, {BISHOP, KNIGHT}, 10 * SQUARES * SQUARES * SQUARES},
+    //the pawn only on the files a-d and on the ranks 2-7
+    {"KPK", 3, {PAWN, EMPTY}, 24 * SQUARES * SQUARES}
+};
+
+static const int king_deltas[] = {MV_U, MV_D, MV_L, MV_R, MV_UL, MV_UR, MV_DL, MV_DR, 0};
+static const int knight_deltas[] = {MV_U * 2 + MV_L, MV_U * 2 + MV_R, MV_R * 2 + MV_U, MV_R * 2 + MV_D,
+    MV_D * 2 + MV_R, MV_D * 2 + MV_L, MV_L * 2 + MV_U, MV_L * 2 + MV_D, 0};
+static const int rook_deltas[] = {MV_U, MV_D, MV_L, MV_R, 0};
+static const int bishop_deltas[] = {MV_UL, MV_UR, MV_DL, MV_DR, 0};
+
+//the king of the strong side is always moved into the a1-d4 triangle by the
+//symmetries of a pawnless board.. index in the triangle or -1
+static int triangle[SQUARES];
+static int triangle_squares[10];
+
+static const int* piece_deltas(int piece, bool& slides) {
+    slides = piece == BISHOP || piece == ROOK || piece == QUEEN;
+    switch (piece) {
+        case KNIGHT:
+            return knight_deltas;
+        case BISHOP:
+            return bishop_deltas;
+        case ROOK:
+            return rook_deltas;
+    }
+    return king_deltas;
+}
+
+static bool adjacent(int a, int b) {
+    return abs(RANK(a) - RANK(b)) <= 1 && abs(FILE(a) - FILE(b)) <= 1;
+}
+
+/*
+ * One of the 8 symmetries of the board (t is a combination of flipping the
+ * files, flipping the ranks and swapping them), for a 0x88 square. Returns
+ * the index of the square 0..63.
+ */
+static int transform(int square, int t) {
+    int file = FILE(square);
+    int rank = RANK(square);
+    if (t & 1) {
+        file ^= 7;
+    }
+    if (t & 2) {
+        rank ^= 7;
+    }
+    if (t & 4) {
+        int tmp = file;
+        file = rank;
+        rank = tmp;
+    }
+    return rank * 8 + file;
+}
+
+static void* run_job(void* data) {
+    tbjob* job = (tbjob*) data;
+    job->tablebase->generate_part(*job);
+    return NULL;
+}
+
+static void* run_generation(void* data) {
+    ((Tablebase*) data)->generate_and_save();
+    return NULL;
+}
+
+Tablebase::Tablebase() : ready(false), generating(false), stopped(false), generator_threads(1) {
+    int count = 0;
+    for (int square = 0; square < SQUARES; square++) {
+        int file = square & 7;
+        int rank = square >> 3;
+        triangle[square] = -1;
+        if (rank <= file && file <= 3) {
+            triangle[square] = count;
+            triangle_squares[count++] = square;
+        }
+    }
+    for (int table = 0; table < TB_TABLES; table++) {
+        tables[table][TB_STRONG] = NULL;
+        tables[table][TB_WEAK] = NULL;
+    }
+}
+
+Tablebase::~Tablebase() {
+    if (generating) {
+        stopped = true;
+        pthread_join(generator, NULL);
+        generating = false;
+    }
+    release();
+}
+
+/*
+ * Doesn't wait for the generation: xboard wants the answers to its first
+ * commands within a few seconds.
+ */
+void Tablebase::init(int threads, const string& file) {
+    if (ready || generating) {
+        return;
+    }
+    allocate();
+    if (!file.empty() && load(file)) {
+        ready = true;
+        return;
+    }
+    this->file = file;
+    generator_threads = threads;
+    stopped = false;
+    if (pthread_create(&generator, NULL, run_generation, this) == 0) {
+        generating = true;
+    } else {
+        generate_and_save();
+    }
+}
+
+void Tablebase::generate_and_save() {
+    cerr << "Generating the endgame tablebases in the background.." << endl;
+    int start = get_ms();
+    if (!generate(generator_threads)) {
+        return;
+    }
+    //the tables must be complete before a probe sees them
+    __sync_synchronize();
+    ready = true;
+    cerr << "Generated the endgame tablebases in " << display_time(start, get_ms()) << "s." << endl;
+    if (file.empty()) {
+        return;
+    }
+    if (save(file)) {
+        cerr << "Saved the endgame tablebases to '" << file << "'." << endl;
+    } else {
+        cerr << "Can not save the tablebases to '" << file << "'." << endl;
+    }
+}
+
+bool Tablebase::is_ready() {
+    return ready;
+}
+
+void Tablebase::allocate() {
+    for (int table = 0; table < TB_TABLES; table++) {
+        for (int side = TB_STRONG; side <= TB_WEAK; side++) {
+            if (tables[table][side] == NULL) {
+                tables[table][side] = new unsigned char[table_info[table].size];
+            }
+        }
+    }
+}
+
+void Tablebase::release() {
+    for (int table = 0; table < TB_TABLES; table++) {
+        for (int side = TB_STRONG; side <= TB_WEAK; side++) {
+            delete[] tables[table][side];
+            tables[table][side] = NULL;
+        }
+    }
+    ready = false;
+}
+
+/*
+ * The file has a small header (magic, version and the number of tables) and
+ * then the size and the values of both sides of every table.
+ */
+bool Tablebase::load(const string& file) {
+    ifstream in(file.c_str(), ios::in | ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    u64 magic = 0;
+    int version = 0;
+    int count = 0;
+    in.read((char*) &magic, sizeof (magic));
+    in.read((char*) &version, sizeof (version));
+    in.read((char*) &count, sizeof (count));
+    if (!in || magic != TB_MAGIC || version != TB_VERSION || count != TB_TABLES) {
+        return false;
+    }
+    for (int table = 0; table < TB_TABLES; table++) {
+        int size = 0;
+        in.read((char*) &size, sizeof (size));
+        if (!in || size != table_info[table].size) {
+            return false;
+        }
+        in.read((char*) tables[table][TB_STRONG], size);
+        in.read((char*) tables[table][TB_WEAK], size);
+    }
+    return !in.fail();
+}
+
+bool Tablebase::save(const string& file) {
+    ofstream out(file.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    u64 magic = TB_MAGIC;
+    int version = TB_VERSION;
+    int count = TB_TABLES;
+    out.write((const char*) &magic, sizeof (magic));
+    out.write((const char*) &version, sizeof (version));
+    out.write((const char*) &count, sizeof (count));
+    for (int table = 0; table < TB_TABLES; table++) {
+        int size = table_info[table].size;
+        out.write((const char*) &size, sizeof (size));
+        out.write((const char*) tables[table][TB_STRONG], size);
+        out.write((const char*) tables[table][TB_WEAK], size);
+    }
+    return !out.fail();
+}
+
+/*
+ * The squares are 0x88 squares: the king of the strong side, the lonely king
+ * and the pieces of the table. The index is the same for all the symmetric
+ * positions.
+ */
+int Tablebase::index(int table, const int* squares) {
+    if (table == TB_KPK) {
+        //only the files can be mirrored with a pawn
+        int mirror = FILE(squares[2]) > 3 ? 7 : 0;
+        int result = (RANK(squares[2]) - 1) * 4 + (FILE(squares[2]) ^ mirror);
+        for (int i = 0; i < 2; i++) {
+            result = result * SQUARES + RANK(squares[i]) * 8 + (FILE(squares[i]) ^ mirror);
+        }
+        return result;
+    }
+    //with the king on the diagonal two symmetries are left.. the smaller
+    //index is taken
+    int best = -1;
+    for (int t = 0; t < 8; t++) {
+        int king = transform(squares[0], t);
+        if (triangle[king] < 0) {
+            continue;
+        }
+        int result = triangle[king];
+        for (int i = 1; i < table_info[table].count; i++) {
+            result = result * SQUARES + transform(squares[i], t);
+        }
+        if (best < 0 || result < best) {
+            best = result;
+        }
+    }
+    return best;
+}
+
+/*
+ * Opposite of index(). Returns false if the position is not possible or if
+ * another index is used for it.
+ */
+bool Tablebase::decode(int table, int index, int* squares) {
+    int count = table_info[table].count;
+    int rest = index;
+    if (table == TB_KPK) {
+        for (int i = 1; i >= 0; i--) {
+            squares[i] = rest % SQUARES;
+            rest /= SQUARES;
+        }
+        squares[2] = (rest / 4 + 1) * 8 + rest % 4;
+    } else {
+        for (int i = count - 1; i > 0; i--) {
+            squares[i] = rest % SQUARES;
+            rest /= SQUARES;
+        }
+        squares[0] = triangle_squares[rest];
+    }
+    //to the 0x88 board
+    for (int i = 0; i < count; i++) {
+        squares[i] += squares[i] & 56;
+    }
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            if (squares[i] == squares[j]) {
+                return false;
+            }
+        }
+    }
+    return !adjacent(squares[0], squares[1]) && this->index(table, squares) == index;
+}
+
+int Tablebase::piece_at(int table, const int* squares, int square) {
+    for (int i = 0; i < table_info[table].count; i++) {
+        if (squares[i] == square) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Returns true if the strong side attacks the target. The lonely king doesn't
+ * block anything (it's the one that wants to go there) and the piece ignore
+ * is captured.
+ */
+bool Tablebase::attacked(int table, const int* squares, int target, int ignore) {
+    if (adjacent(squares[0], target)) {
+        return true;
+    }
+    for (int i = 2; i < table_info[table].count; i++) {
+        if (i == ignore) {
+            continue;
+        }
+        int piece = table_info[table].pieces[i - 2];
+        if (piece == PAWN) {
+            if (target - squares[i] == MV_UL || target - squares[i] == MV_UR) {
+                return true;
+            }
+            continue;
+        }
+        bool slides;
+        const int* deltas = piece_deltas(piece, slides);
+        for (int d = 0; deltas[d] != 0; d++) {
+            for (int square = squares[i] + deltas[d]; !(square & 0x88); square += deltas[d]) {
+                if (square == target) {
+                    return true;
+                }
+                int blocker = piece_at(table, squares, square);
+                if (!slides || (blocker >= 0 && blocker != 1 && blocker != ignore)) {
+                    break;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * Looks at the moves of the lonely king (the weak side is to move). Returns the
+ * highest value of the positions it can reach, 0 if one of them is not won
+ * (yet) or is a draw, and -1 if there is no legal move.
+ */
+int Tablebase::worst_reply(int table, const int* squares) {
+    int child[TB_MAX_PIECES];
+    memcpy(child, squares, sizeof (child));
+    int worst = -1;
+    for (int d = 0; king_deltas[d] != 0; d++) {
+        int to = squares[1] + king_deltas[d];
+        if ((to & 0x88) || adjacent(to, squares[0])) {
+            continue;
+        }
+        int captured = piece_at(table, squares, to);
+        if (attacked(table, squares, to, captured)) {
+            continue;
+        }
+        //without one of the pieces every ending of the tables is a draw
+        if (captured >= 0) {
+            return 0;
+        }
+        child[1] = to;
+        int value = tables[table][TB_STRONG][index(table, child)];
+        if (value == 0) {
+            return 0;
+        }
+        if (value > worst) {
+            worst = value;
+        }
+    }
+    return worst;
+}
+
+/*
+ * KPK with the strong side to move: the pawn promotes into a won KQK or KRK.
+ */
+bool Tablebase::wins_by_promotion(const int* squares) {
+    int promotion = squares[2] + MV_U;
+    if (RANK(squares[2]) != 6 || piece_at(TB_KPK, squares, promotion) >= 0) {
+        return false;
+    }
+    int promoted[TB_MAX_PIECES] = {squares[0], squares[1], promotion, 0};
+    return tables[TB_KQK][TB_WEAK][index(TB_KQK, promoted)] != 0
+            || tables[TB_KRK][TB_WEAK][index(TB_KRK, promoted)] != 0;
+}
+
+/*
+ * The lonely king is to move and lost: all the moves of the strong side that
+ * lead here win.
+ */
+void Tablebase::add_strong_predecessors(tbjob& job, const int* squares) {
+    const tbinfo& info = table_info[job.table];
+    int previous[TB_MAX_PIECES];
+    memcpy(previous, squares, sizeof (previous));
+    for (int i = 0; i < info.count; i++) {
+        if (i == 1) {
+            continue;
+        }
+        int piece = i == 0 ? KING : info.pieces[i - 2];
+        int from[32];
+        int count = 0;
+        if (piece == PAWN) {
+            //no captures, only the pawn of the strong side moving up
+            if (RANK(squares[i]) >= 2 && piece_at(job.table, squares, squares[i] + MV_D) < 0) {
+                from[count++] = squares[i] + MV_D;
+                if (RANK(squares[i]) == 3 && piece_at(job.table, squares, squares[i] + 2 * MV_D) < 0) {
+                    from[count++] = squares[i] + 2 * MV_D;
+                }
+            }
+        } else {
+            bool slides;
+            const int* deltas = piece_deltas(piece, slides);
+            for (int d = 0; deltas[d] != 0; d++) {
+                for (int square = squares[i] + deltas[d]; !(square & 0x88); square += deltas[d]) {
+                    if (piece_at(job.table, squares, square) >= 0) {
+                        break;
+                    }
+                    from[count++] = square;
+                    if (!slides) {
+                        break;
+                    }
+                }
+            }
+        }
+        for (int f = 0; f < count; f++) {
+            previous[i] = from[f];
+            //the lonely king can't be in check before the strong side moves
+            if (attacked(job.table, previous, previous[1], -1)) {
+                continue;
+            }
+            unsigned char* value = &tables[job.table][TB_STRONG][index(job.table, previous)];
+            if (__sync_bool_compare_and_swap(value, 0, job.distance + 1)) {
+                job.found++;
+            }
+        }
+        previous[i] = squares[i];
+    }
+}
+
+/*
+ * The strong side is to move and wins: the lonely king came from one of its
+ * neighbours, and that position is lost if all the other moves lose as well.
+ */
+void Tablebase::add_weak_predecessors(tbjob& job, const int* squares) {
+    int previous[TB_MAX_PIECES];
+    memcpy(previous, squares, sizeof (previous));
+    for (int d = 0; king_deltas[d] != 0; d++) {
+        int from = squares[1] + king_deltas[d];
+        if ((from & 0x88) || adjacent(from, squares[0]) || piece_at(job.table, squares, from) >= 0) {
+            continue;
+        }
+        previous[1] = from;
+        unsigned char* value = &tables[job.table][TB_WEAK][index(job.table, previous)];
+        if (*value != 0) {
+            continue;
+        }
+        int worst = worst_reply(job.table, previous);
+        if (worst > 0 && __sync_bool_compare_and_swap(value, 0, worst + 1)) {
+            job.found++;
+        }
+    }
+}
+
+/*
+ * Layer 0 are the mates. The odd layers are positions where the strong side
+ * wins in distance plies, found from the lost positions of the layer before.
+ * The even layers are the lost positions of the lonely king.
+ */
+void Tablebase::generate_part(tbjob& job) {
+    unsigned char* strong = tables[job.table][TB_STRONG];
+    unsigned char* weak = tables[job.table][TB_WEAK];
+    int squares[TB_MAX_PIECES];
+    for (int i = job.first; i < job.last; i++) {
+        if (job.distance == 0) {
+            if (decode(job.table, i, squares) && attacked(job.table, squares, squares[1], -1)
+                    && worst_reply(job.table, squares) < 0) {
+                weak[i] = 1;
+                job.found++;
+            }
+        } else if (job.distance & 1) {
+            //the promotions of KPK are the goal too
+            if (job.distance == 1 && job.table == TB_KPK && decode(job.table, i, squares)
+                    && !attacked(job.table, squares, squares[1], -1) && wins_by_promotion(squares)
+                    && __sync_bool_compare_and_swap(&strong[i], 0, 2)) {
+                job.found++;
+            }
+            if (weak[i] == job.distance && decode(job.table, i, squares)) {
+                add_strong_predecessors(job, squares);
+            }
+        } else if (strong[i] == job.distance && decode(job.table, i, squares)) {
+            add_weak_predecessors(job, squares);
+        }
+    }
+}
+
+/*
+ * Splits a layer between the threads. Returns the number of new positions.
+ */
+int Tablebase::generate_layer(int table, int distance, int threads) {
+    int size = table_info[table].size;
+    tbjob jobs[MAX_THREADS];
+    pthread_t workers[MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        jobs[t].tablebase = this;
+        jobs[t].table = table;
+        jobs[t].distance = distance;
+        jobs[t].first = (int) ((long long) size * t / threads);
+        jobs[t].last = (int) ((long long) size * (t + 1) / threads);
+        jobs[t].found = 0;
+    }
+    for (int t = 1; t < threads; t++) {
+        pthread_create(&workers[t], NULL, run_job, &jobs[t]);
+    }
+    generate_part(jobs[0]);
+    int found = jobs[0].found;
+    for (int t = 1; t < threads; t++) {
+        pthread_join(workers[t], NULL);
+        found += jobs[t].found;
+    }
+    return found;
+}
+
+/*
+ * Returns false if it was stopped before all the tables were done.
+ */
+bool Tablebase::generate(int threads) {
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+    for (int table = 0; table < TB_TABLES; table++) {
+        int size = table_info[table].size;
+        memset(tables[table][TB_STRONG], 0, size);
+        memset(tables[table][TB_WEAK], 0, size);
+        //KPK might not have mates, but its promotions start at layer 1
+        int distance = 0;
+        while (!stopped && (generate_layer(table, distance, threads) > 0 || distance == 0)) {
+            distance++;
+        }
+        if (stopped) {
+            return false;
+        }
+#ifdef DEBUG
+        cerr << table_info[table].name << ": " << distance - 1 << " plies at most" << endl;
+#endif
+    }
+    return true;
+}
+
+bool Tablebase::probe(Board& board, int ply, int& score) {
+    if (!ready || board.pieces > TB_MAX_PIECES) {
+        return false;
+    }
+    int strong = EMPTY;
+    int pieces[TB_MAX_PIECES];
+    int piece_squares[TB_MAX_PIECES];
+    int count = 0;
+    for (int square = A1; square <= H8; square++) {
+        int piece = board.board[square];
+        if ((square & 0x88) || piece == EMPTY || abs(piece) == KING) {
+            continue;
+        }
+        int color = piece > EMPTY ? WHITE : BLACK;
+        //both sides have pieces
+        if (strong != EMPTY && color != strong) {
+            return false;
+        }
+        strong = color;
+        pieces[count] = abs(piece);
+        piece_squares[count++] = square;
+    }
+    //kings alone, or with a minor piece
+    if (count == 0 || (count == 1 && (pieces[0] == KNIGHT || pieces[0] == BISHOP))) {
+        score = DRAW;
+        return true;
+    }
+
+    int table = -1;
+    if (count == 1) {
+        switch (pieces[0]) {
+            case QUEEN:
+                table = TB_KQK;
+                break;
+            case ROOK:
+                table = TB_KRK;
+                break;
+            case PAWN:
+                table = TB_KPK;
+                break;
+        }
+    } else if (count == 2 && ((pieces[0] == BISHOP && pieces[1] == KNIGHT)
+            || (pieces[0] == KNIGHT && pieces[1] == BISHOP))) {
+        table = TB_KBNK;
+        //the bishop is first
+        if (pieces[0] == KNIGHT) {
+            int tmp = piece_squares[0];
+            piece_squares[0] = piece_squares[1];
+            piece_squares[1] = tmp;
+        }
+    }
+    if (table < 0) {
+        return false;
+    }
+
+    int squares[TB_MAX_PIECES];
+    squares[0] = strong == WHITE ? board.white_king : board.black_king;
+    squares[1] = strong == WHITE ? board.black_king : board.white_king;
+    for (int i = 0; i < count; i++) {
+        squares[i + 2] = piece_squares[i];
+    }
+    //the pawn of KPK is always white
+    if (table == TB_KPK && strong == BLACK) {
+        for (int i = 0; i < 3; i++) {
+            squares[i] ^= 0x70;
+        }
+    }
+
+    int side = board.to_move == strong ? TB_STRONG : TB_WEAK;
+    int value = tables[table][side][index(table, squares)];
+    if (value == 0) {
+        score = DRAW;
+        return true;
+    }
+    int distance = value - 1;
+    if (table != TB_KPK && ply + distance < MAX_PLY) {
+        score = -MATED_IN(ply + distance);
+    } else {
+        score = TABLEBASE_WIN - ply - distance;
+    }
+    if (side == TB_WEAK) {
+        score = -score;
+    }
+    return true;
+}
+
+/*
+ * Plays the move with the best tablebase score of a won or lost position. All
+ * the moves of a drawn position are worth the same for the tables, the search
+ * picks one of them.
+ */
+bool Tablebase::probe_root(Board& board, move& best) {
+    int score;
+    if (!probe(board, 0, score) || score == DRAW) {
+        return false;
+    }
+    MoveGenerator generator(&board);
+    generator.generate_all_moves();
+    vector<move>& moves = generator.get_all_moves();
+    int best_score = 0;
+    for (unsigned i = 0; i < moves.size(); i++) {
+        board.fake_move(moves[i]);
+        bool known = probe(board, 1, score);
+        board.unfake_move();
+        if (!known) {
+            return false;
+        }
+        if (i == 0 || -score > best_score) {
+            best_score = -score;
+            best = moves[i];
+        }
+    }
+    return !moves.empty();
+}
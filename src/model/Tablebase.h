@@ -0,0 +1,134 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#ifndef TABLEBASE_H_
+#define TABLEBASE_H_
+
+#include <string>
+#include <pthread.h>
+#include "../common/define.h"
+#include "../common/utils.h"
+#include "Board.h"
+
+using std::string;
+
+//bump it whenever the indexes or the values of the tables change.. old files
+//are generated again then
+#define TB_VERSION  1
+#define TB_MAGIC    0x7461626c65626173ULL
+
+//the endings, in the order of the generation (KPK needs KQK and KRK)
+#define TB_KQK      0
+#define TB_KRK      1
+#define TB_KBNK     2
+#define TB_KPK      3
+#define TB_TABLES   4
+
+//side to move of a table
+#define TB_STRONG   0
+#define TB_WEAK     1
+
+/*
+ * One of the endings: the strong side has a king and the pieces, the weak side
+ * only the king.
+ */
+typedef struct {
+    const char* name;
+    //with the kings
+    int count;
+    //pieces of the strong side besides the king, in the order of the index
+    int pieces[TB_MAX_PIECES - 2];
+    //positions for each side to move
+    int size;
+} tbinfo;
+
+class Tablebase;
+
+/*
+ * Part of a layer of the generation, done by one thread.
+ */
+typedef struct {
+    Tablebase* tablebase;
+    int table;
+    int distance;
+    int first;
+    int last;
+    //new positions of the layer
+    int found;
+} tbjob;
+
+/*
+ * Retrograde endgame tablebases for up to TB_MAX_PIECES pieces, kept in memory.
+ *
+ * Every position of an ending has a byte per side to move: 0 is a draw (or an
+ * illegal position), otherwise value - 1 is the distance to the mate in plies.
+ * KPK counts the plies to a promotion that wins instead, so the tables of KQK
+ * and KRK are known once the pawn promotes.
+ *
+ * The tables are built layer by layer backwards from the mates, with a few
+ * threads in the background, and saved to a file so the next start only has
+ * to read them. Until they are done the probes don't know any position.
+ */
+class Tablebase {
+public:
+    Tablebase();
+    ~Tablebase();
+
+    //loads the tables from the file, or starts to generate them (and save
+    //them if the file isn't empty)
+    void init(int threads, const string& file);
+    bool is_ready();
+
+    //score of the position for the side to move, false if it's not in the
+    //tables
+    bool probe(Board& board, int ply, int& score);
+    //best move of a position that is in the tables
+    bool probe_root(Board& board, move& best);
+
+    //called by the thread of the generation in the background
+    void generate_and_save();
+    //one part of a layer, called by the generating threads
+    void generate_part(tbjob& job);
+
+private:
+    unsigned char* tables[TB_TABLES][2];
+    volatile bool ready;
+    //the generation in the background, stopped if we quit before it's done
+    pthread_t generator;
+    bool generating;
+    volatile bool stopped;
+    int generator_threads;
+    string file;
+
+    void allocate();
+    void release();
+    bool load(const string& file);
+    bool save(const string& file);
+
+    bool generate(int threads);
+    int generate_layer(int table, int distance, int threads);
+
+    int index(int table, const int* squares);
+    bool decode(int table, int index, int* squares);
+    int piece_at(int table, const int* squares, int square);
+    bool attacked(int table, const int* squares, int target, int ignore);
+    int worst_reply(int table, const int* squares);
+    bool wins_by_promotion(const int* squares);
+    void add_strong_predecessors(tbjob& job, const int* squares);
+    void add_weak_predecessors(tbjob& job, const int* squares);
+};
+
+//the tablebases are shared by all the players of this process
+extern Tablebase tablebases;
+
+#endif /* TABLEBASE_H_ */
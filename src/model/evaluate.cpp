@@ -194,6 +194,23 @@ int repetitions(Board* b) {
     return r;
 }
 
+/*
+ * Has the side any piece besides the king and the pawns? In pawn endings a
+ * zugzwang is common, so the null move is not allowed there.
+ */
+bool has_pieces(Board* b, int color) {
+    for (int square = 0; square < BOARD_SIZE; square++) {
+        if ((square & 15) == 8) {
+            square += 8;
+        }
+        int piece = b->board[square] * color;
+        if (piece > PAWN && piece < KING) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int evaluate(Board* b) {
     // score for both sides
     int score_white = 0;
@@ -26,5 +26,6 @@ extern int evaluate_rook(Board* b, int sq);
 extern int evaluate_queen(Board* b, int sq);
 extern int evaluate_king(Board* b, int sq, int material_white, int material_black);
 extern int repetitions(Board* b);
+extern bool has_pieces(Board* b, int color);
 
 #endif /* EVALUATE_H_ */
@@ -12,6 +12,7 @@
  */
 
 #include "ComputerPlayer.h"
+#include <unistd.h>
 
 using std::cout;
 using std::cerr;
@@ -25,18 +26,38 @@ using std::ios;
 using std::endl;
 
 ComputerPlayer::ComputerPlayer(bool use_book) :
-Player(), use_opening_book(use_book) {
+Player(), use_opening_book(use_book), best_move_time(0), overshoot(-1),
+search_threads(1), nps(0), clock_start(0), deadline(0), pondering(false),
+ponder_running(false), game_board(NULL), analyzing(false), current_depth(0), expected_length(0),
+expected_depth(0), expected_score(0), expected_history_size(0), total_searches(0),
+predicted_searches(0), aspiration_iterations(0), aspiration_researches(0) {
     name = PROJECT_NAME;
     name.append(" ");
     name.append(VERSION);
     cout.setf(ios::unitbuf);
+    pthread_mutex_init(&ponder_lock, NULL);
+    for (int d = 0; d < MAX_PLY; d++) {
+        depth_time[d] = 0;
+        depth_count[d] = 0;
+    }
+    for (int l = 0; l < MAX_MULTI_PV; l++) {
+        multi_length[l] = 0;
+    }
+}
+
+ComputerPlayer::~ComputerPlayer() {
+    stop_pondering();
+    for (unsigned i = 0; i < helpers.size(); i++) {
+        delete helpers[i];
+    }
+    pthread_mutex_destroy(&ponder_lock);
 }
 
 move ComputerPlayer::get_move() {
     move m;
 
 #ifdef USE_OPENING_BOOK
-    if (use_opening_book && opening_book.is_opened()) {
+    if (use_opening_book && opening_book.is_opened() && !analyzing) {
         MoveGenerator generator(board);
         generator.generate_all_moves();
         vector<move>& moves = generator.get_all_moves();
@@ -49,316 +70,712 @@ move ComputerPlayer::get_move() {
     }
 #endif
 
+#ifdef USE_TABLEBASES
+    if (!analyzing && board->pieces <= TB_MAX_PIECES && tablebases.probe_root(*board, m)) {
+        if (!xboard) {
+            cout << " from tablebases: " << move_to_algebraic(m, *board) << endl;
+        }
+        return m;
+    }
+#endif
+
     if (!xboard) {
         cout << " thinking... " << endl;
     }
-    m = search_pv();
+    stop_search = false;
+    m = parallel_search == SMP_MCTS ? search_tree() : search_pv();
     return m;
 }
 
-move ComputerPlayer::search_pv() {
-    int start_time = get_ms();
-    //time is in seconds
-    board->stop_time = start_time + max_thinking_time * 1000;
-    board->time_exit = false;
-
-    board->ply = 0;
-    board->checked_nodes = 0;
+/*
+ * Milliseconds after the start of the last search when the best move was found
+ */
+int ComputerPlayer::get_best_move_time() {
+    return best_move_time;
+}
 
-    memset(board->pv, 0, sizeof (board->pv));
+int ComputerPlayer::get_overshoot() {
+    return overshoot;
+}
 
-    if (!xboard && show_thinking) {
-        cout << "ply  score   time   nodes  pv\n";
+int ComputerPlayer::get_checked_nodes() {
+    int nodes = main_thread.checked_nodes;
+    for (int i = 0; i < search_threads - 1 && i < (int) helpers.size(); i++) {
+        nodes += helpers[i]->checked_nodes;
     }
+    return nodes;
+}
 
-    move best_moves[MAX_SEARCH_DEPTH];
-    int best_scores[MAX_SEARCH_DEPTH];
-    int best_moves_plys[MAX_SEARCH_DEPTH];
+int ComputerPlayer::get_quiescence_nodes() {
+    int nodes = main_thread.quiescence_nodes;
+    for (int i = 0; i < search_threads - 1 && i < (int) helpers.size(); i++) {
+        nodes += helpers[i]->quiescence_nodes;
+    }
+    return nodes;
+}
 
-    int depth = 1;
-    bool found_checkmate = false;
-    for (; depth <= max_search_depth && !board->time_exit; depth++) {
-        board->follow_pv = true;
-        int score = alpha_beta(depth, -EVALUATION_START, EVALUATION_START);
-        best_moves[depth] = board->pv[0][0];
-        best_moves_plys[depth] = board->pv_length[0];
-        best_scores[depth] = score;
+int ComputerPlayer::get_beta_cutoffs() {
+    int cutoffs = main_thread.beta_cutoffs;
+    for (int i = 0; i < search_threads - 1 && i < (int) helpers.size(); i++) {
+        cutoffs += helpers[i]->beta_cutoffs;
+    }
+    return cutoffs;
+}
 
-        if (show_thinking) {
-            if (!board->time_exit) {
-                if (xboard) {
-                    //ply score time nodes pv
-                    int centiseconds = (int) ((double) (get_ms() - start_time) / 10);
-                    cout << setw(3) << depth;
-                    cout << setw(7) << score << " ";
-                    cout << setw(5) << centiseconds << " ";
-                    cout << setw(8) << board->checked_nodes << " ";
-                } else {
-                    printf("%3d %6s %6s %7s  ", depth,
-                            display_score(score),
-                            display_time(start_time, get_ms()),
-                            display_nodes_count(board->checked_nodes));
-                }
-                //you have to simulate the game to print the algebraic correct
-                Board temp_board = Board(*board);
-                for (int j = 0; j < board->pv_length[0]; ++j) {
-                    if (board->to_move == BLACK) {
-                        if (j == 0) {
-                            cout << board->full_moves << ". ... ";
-                        } else {
-                            if ((j + 1) % 2 == 0) {
-                                cout << board->full_moves + (j / 2 + 1) << ". ";
-                            }
-                        }
-                    } else {
-                        if (j % 2 == 0) {
-                            cout << board->full_moves + (j / 2) << ". ";
-                        }
-                    }
-                    cout << move_to_algebraic(board->pv[0][j], temp_board) << " ";
-                    temp_board.play_move(board->pv[0][j]);
-                }
-                cout << endl;
-            }
-        }
-        if (abs(score) >= MATE) {
-            found_checkmate = true;
-            break;
-        }
+int ComputerPlayer::get_first_move_cutoffs() {
+    int cutoffs = main_thread.first_move_cutoffs;
+    for (int i = 0; i < search_threads - 1 && i < (int) helpers.size(); i++) {
+        cutoffs += helpers[i]->first_move_cutoffs;
     }
+    return cutoffs;
+}
 
-    move best_move;
-    int best_move_plys;
-    int best_score;
-
-    if (board->time_exit) {
-        best_move = best_moves[depth - 2];
-        best_move_plys = best_moves_plys[depth - 2];
-        best_score = best_scores[depth - 2];
-    } else if (found_checkmate) {
-        best_move = best_moves[depth];
-        best_move_plys = best_moves_plys[depth];
-        best_score = best_scores[depth];
+int ComputerPlayer::get_playouts() {
+    return parallel_search == SMP_MCTS ? tree.get_playouts() : 0;
+}
+
+static void* run_helper(void* data) {
+    SearchThread* thread = (SearchThread*) data;
+    if (thread->tree != NULL) {
+        thread->tree->run(*thread);
+    } else if (thread->team != NULL) {
+        thread->idle_loop();
     } else {
-        best_move = best_moves[depth - 1];
-        best_move_plys = best_moves_plys[depth - 1];
-        best_score = best_scores[depth - 1];
+        thread->iterate(MAX_SEARCH_DEPTH);
     }
+    return NULL;
+}
 
-#ifdef SHOW_SEARCH_INFO
-    if (!xboard) {
-        float total_time = (float) (get_ms() - start_time) / 1000;
-        printf("%s nodes searched in %.2f secs (%.1fK nodes/sec)\n",
-                display_nodes_count(board->checked_nodes), total_time,
-                (board->checked_nodes / 1000.0) / total_time);
+void ComputerPlayer::start_helpers() {
+    while ((int) helpers.size() < search_threads - 1) {
+        helpers.push_back(new SearchThread(helpers.size() + 1));
     }
-#endif
+    SearchTeam* split_team = NULL;
+    if (search_threads > 1 && parallel_search == SMP_SPLIT_POINTS) {
+        split_team = &team;
+        team.size = search_threads;
+        team.idle = 0;
+        team.done = false;
+        team.threads[0] = &main_thread;
+    }
+    MonteCarloTree* playouts = parallel_search == SMP_MCTS ? &tree : NULL;
+    main_thread.team = split_team;
+    for (int i = 0; i < search_threads - 1; i++) {
+        helpers[i]->set_position(*board);
+        helpers[i]->reset(&stop_search);
+        helpers[i]->team = split_team;
+        helpers[i]->tree = playouts;
+        team.threads[i + 1] = helpers[i];
+    }
+    for (int i = 0; i < search_threads - 1; i++) {
+        pthread_create(&helper_threads[i], NULL, run_helper, helpers[i]);
+    }
+}
 
-    if (!xboard && show_best_score) {
-        cout << "Score for move " << move_to_algebraic(best_move, *board) << " is ";
-        cout << display_score(best_score) << " (" << best_move_plys << " plys)";
-        cout << endl;
+void ComputerPlayer::stop_helpers() {
+    team.done = true;
+    stop_search = true;
+    for (int i = 0; i < search_threads - 1; i++) {
+        pthread_join(helper_threads[i], NULL);
     }
-    return best_move;
 }
 
-int ComputerPlayer::alpha_beta(int depth, int alpha, int beta) {
+/*
+ * Checks if the opponent answered our last move with the reply from the PV.
+ * In that case the rest of the line (shifted by two plies) is the best guess
+ * for this search and the transposition table knows it already.
+ */
+bool ComputerPlayer::predicted_reply() {
+    unsigned size = board->history.size();
+    return expected_length > 2 && size == expected_history_size + 2
+            && board->history[size - 2].m == expected_line[0]
+            && board->history[size - 1].m == expected_line[1];
+}
 
-    if (depth == 0) {
-        return quiescence(alpha, beta);
+void ComputerPlayer::set_level(int moves, int base, int increment) {
+    time_manager.set_level(moves, base, increment);
+}
+
+void ComputerPlayer::set_time(int remaining) {
+    time_manager.set_time(remaining);
+}
+
+void ComputerPlayer::set_opponent_time(int remaining) {
+    time_manager.set_opponent_time(remaining);
+}
+
+void ComputerPlayer::set_nps(int nodes) {
+    nps = nodes < 0 ? 0 : nodes;
+}
+
+int ComputerPlayer::elapsed_time(int start_time, int start_nodes) {
+    if (nps > 0) {
+        return (int) ((double) (get_checked_nodes() - start_nodes) * 1000 / nps);
     }
-    board->checked_nodes++;
+    return get_ms() - start_time;
+}
+
+void* ComputerPlayer::run_ponder(void* data) {
+    ComputerPlayer* player = (ComputerPlayer*) data;
+    player->ponder_result = player->parallel_search == SMP_MCTS ? player->search_tree()
+            : player->search_pv();
+    return NULL;
+}
 
-    // check the time every 4096 nodes
-    if ((board->checked_nodes & 4095) == 0) {
-        if (get_ms() > board->stop_time) {
-            board->time_exit = true;
-            return 0;
+/*
+ * The ponder move is the reply from the PV of our last search, so it can only
+ * be called right after our move was played on the board (or while pondering).
+ */
+move ComputerPlayer::get_ponder_move() {
+    if (ponder_running) {
+        return ponder_move;
+    }
+    move m;
+    m.move = 0;
+    unsigned size = board->history.size();
+    if (expected_length < 2 || size != expected_history_size + 1
+            || !(board->history[size - 1].m == expected_line[0])) {
+        return m;
+    }
+    MoveGenerator generator(board);
+    generator.generate_all_moves();
+    vector<move>& moves = generator.get_all_moves();
+    for (unsigned i = 0; i < moves.size(); i++) {
+        if (moves[i] == expected_line[1]) {
+            return moves[i];
         }
     }
+    return m;
+}
 
-#ifdef USE_HASH_TABLE
-    // EXPERIMENTAL: check for a hash entry
-    switch (board->hash_probe(depth, &alpha, beta)) {
-        case EXACT:
-            if (alpha < beta) {
-
-                board->pv_length[board->ply] = board->ply;
-                htentry* entry = board->hash_entry(board->get_hash());
-                board->pv[board->ply][board->ply] = entry->best;
-
-                for (int j = board->ply + 1; j < board->pv_length[board->ply
-                        + 1]; ++j) {
-                    board->pv[board->ply][j] = board->pv[board->ply + 1][j];
-                }
-                board->pv_length[board->ply] = board->pv_length[board->ply + 1];
+bool ComputerPlayer::start_pondering() {
+    pthread_mutex_lock(&ponder_lock);
+    end_pondering();
+    bool started = begin_pondering();
+    pthread_mutex_unlock(&ponder_lock);
+    return started;
+}
 
-            }
-            return alpha;
-        case LOWER:
-            return beta;
-        case UPPER:
-            return alpha;
-        case NO:
-            break;
+bool ComputerPlayer::begin_pondering() {
+    //only real time can be gained, searches on nodes have to be repeatable
+    if (max_nodes > 0 || nps > 0 || !(time_manager.has_clock() || max_thinking_time > 0)) {
+        return false;
+    }
+    ponder_move = get_ponder_move();
+    if (ponder_move.move == 0) {
+        return false;
+    }
+    ponder_board = *board;
+    ponder_board.play_move(ponder_move);
+    //with one legal move (or none) there is nothing to think about
+    MoveGenerator generator(&ponder_board);
+    generator.generate_all_moves();
+    if (generator.get_all_moves().size() < 2) {
+        return false;
     }
-#endif // USE_HASH_TABLE
-    board->pv_length[board->ply] = board->ply;
+    game_board = board;
+    board = &ponder_board;
+    stop_search = false;
+    pondering = true;
+    ponder_running = true;
+    pthread_create(&ponder_thread, NULL, run_ponder, this);
+    return true;
+}
+
+bool ComputerPlayer::is_pondering() {
+    pthread_mutex_lock(&ponder_lock);
+    bool running = ponder_running;
+    pthread_mutex_unlock(&ponder_lock);
+    return running;
+}
+
+move ComputerPlayer::ponder_hit() {
+    time_manager.start_move(board->history.size() / 2, max_thinking_time * 1000);
+    clock_start = get_ms();
+    deadline = clock_start + time_manager.get_hard_limit();
+    timer.start(deadline, &stop_search);
+    //the search only looks at the clock when it's not pondering anymore
+    __sync_synchronize();
+    pthread_mutex_lock(&ponder_lock);
+    pondering = false;
+    pthread_join(ponder_thread, NULL);
+    ponder_running = false;
+    board = game_board;
+    pthread_mutex_unlock(&ponder_lock);
+    return ponder_result;
+}
+
+void ComputerPlayer::set_analyze(bool analyze) {
+    analyzing = analyze;
+}
 
+/*
+ * stat01 TIME NODES DEPTH MOVES_LEFT TOTAL_MOVES CURRENT_MOVE of the running
+ * analysis. It's called from the input thread, so the values can be a bit off.
+ */
+void ComputerPlayer::print_status() {
+    move current = main_thread.root_move;
+    int total = main_thread.root_moves;
+    int number = main_thread.root_move_number;
+    std::ostringstream line;
+    line << "stat01 " << (get_ms() - clock_start) / 10 << " " << get_checked_nodes();
+    line << " " << current_depth << " " << total - number << " " << total;
+    //the move could be torn, only a legal one is printed
     MoveGenerator generator(board);
     generator.generate_all_moves();
     vector<move>& moves = generator.get_all_moves();
-
-    // are we in check? so we search deeper
-    bool check = generator.king_under_check;
-    if (check) {
-        depth++;
+    for (unsigned i = 0; i < moves.size(); i++) {
+        if (moves[i] == current) {
+            line << " " << move_to_algebraic(moves[i], *board);
+            break;
+        }
     }
+    line << "\n";
+    cout << line.str();
+}
 
-    // If this is a root node, we can't just return 0, we need a move.
-    // else we check for a repetition and assume that this is a draw.
-    if (board->ply > 0 && repetitions(board)) {
-        return DRAW;
+void ComputerPlayer::move_now() {
+    if (!pondering) {
+        stop_search = true;
     }
+}
 
-    //TODO: maybe it's better to use the get_all_moves(move best_move) from
-    // move generator, cause this function puts the best move in front without
-    // changing of the moves.. don't forget that they are sorted
-    if (board->follow_pv) {
-        sort_pv(moves);
-    }
+void ComputerPlayer::stop_pondering() {
+    pthread_mutex_lock(&ponder_lock);
+    end_pondering();
+    pthread_mutex_unlock(&ponder_lock);
+}
 
-    bool played_move = false;
-    int score = 0;
-    bool pv_search = true;
+void ComputerPlayer::end_pondering() {
+    if (!ponder_running) {
+        return;
+    }
+    stop_search = true;
+    pthread_join(ponder_thread, NULL);
+    ponder_running = false;
+    pondering = false;
+    board = game_board;
+}
 
-#ifdef USE_HASH_TABLE
-    int o_alpha = alpha;
-    move best;
-#endif
+/*
+ * Multi-PV: after the best line of the iteration every next line is searched
+ * at the same depth with the moves of the better lines excluded at the root.
+ * The previous line of the same rank is followed first. Returns how many lines
+ * are complete, the best line is left in the PV of the main thread.
+ */
+int ComputerPlayer::search_other_lines(int depth, int score, int root_moves) {
+    int count = multi_pv < root_moves ? multi_pv : root_moves;
+    multi_score[0] = score;
+    multi_length[0] = main_thread.pv_length;
+    memcpy(multi_lines[0], main_thread.pv, sizeof (move) * main_thread.pv_length);
+    int lines = 1;
+    main_thread.excluded_moves.clear();
+    for (int l = 1; l < count; l++) {
+        main_thread.excluded_moves.push_back(multi_lines[l - 1][0]);
+        main_thread.pv_length = multi_length[l];
+        memcpy(main_thread.pv, multi_lines[l], sizeof (move) * multi_length[l]);
+        int line_score = main_thread.search(depth);
+        if (main_thread.time_exit || main_thread.root_best.move == 0) {
+            break;
+        }
+        multi_score[l] = line_score;
+        multi_length[l] = main_thread.pv_length;
+        memcpy(multi_lines[l], main_thread.pv, sizeof (move) * main_thread.pv_length);
+        lines++;
+    }
+    main_thread.excluded_moves.clear();
+    main_thread.pv_length = multi_length[0];
+    memcpy(main_thread.pv, multi_lines[0], sizeof (move) * multi_length[0]);
+    return lines;
+}
 
-    for (unsigned index = 0; index < moves.size(); index++) {
-        board->fake_move(moves[index]);
-        played_move = true;
-        if (pv_search) {
-            score = -alpha_beta(depth - 1, -beta, -alpha);
+/*
+ * One line of the thinking output, with the moves in algebraic notation.
+ */
+void ComputerPlayer::print_line(int depth, int score, const move* line_moves, int length,
+        int start_time) {
+    //xboard reads the commands meanwhile, so the line is written at once
+    std::ostringstream line;
+    if (xboard) {
+        //ply score time nodes pv
+        int centiseconds = (int) ((double) (get_ms() - start_time) / 10);
+        line << setw(3) << depth;
+        line << setw(7) << score << " ";
+        line << setw(5) << centiseconds << " ";
+        line << setw(8) << get_checked_nodes() << " ";
+    } else {
+        printf("%3d %6s %6s %7s %2d  ", depth,
+                display_score(score),
+                display_time(start_time, get_ms()),
+                display_nodes_count(get_checked_nodes()),
+                main_thread.researches);
+    }
+    //you have to simulate the game to print the algebraic correct
+    Board temp_board = Board(*board);
+    for (int j = 0; j < length; ++j) {
+        if (board->to_move == BLACK) {
+            if (j == 0) {
+                line << board->full_moves << ". ... ";
+            } else {
+                if ((j + 1) % 2 == 0) {
+                    line << board->full_moves + (j / 2 + 1) << ". ";
+                }
+            }
         } else {
-            score = -alpha_beta(depth - 1, -alpha - 1, -alpha);
-            if (score > alpha && score < beta) {
-                // re-search
-                score = -alpha_beta(depth - 1, -beta, -alpha);
+            if (j % 2 == 0) {
+                line << board->full_moves + (j / 2) << ". ";
             }
         }
-        board->unfake_move();
+        line << move_to_algebraic(line_moves[j], temp_board) << " ";
+        temp_board.play_move(line_moves[j]);
+    }
+    line << "\n";
+    cout << line.str();
+}
 
-        // we have no time left
-        if (board->time_exit) {
-            return 0;
-        }
+/*
+ * Limits of a search: a node limit, the clock of the game (real, or counted in
+ * nodes with nps), a fixed time per move or no time limit at all, and always
+ * max_search_depth. A search with a node limit never looks at the clock, so it
+ * finds the same move with the same number of nodes on every run.
+ */
+move ComputerPlayer::search_pv() {
+    int start_time = get_ms();
+    clock_start = start_time;
+    //our moves since the start of the game (or the position)
+    time_manager.start_move(board->history.size() / 2, max_thinking_time * 1000);
 
-        if (score > alpha) {
-            if (score >= beta) {
+    //the result of the last finished iteration
+    move best_move;
+    int best_move_plys = 0;
+    int best_score = 0;
+    int finished_depth = 0;
 
-#ifdef USE_HASH_TABLE
-                board->hash_store(depth, LOWER, score, moves[index]);
-#endif // USE_HASH_TABLE
-                return score;
-            }
-            alpha = score;
+    //if we don't finish even one iteration.. play something
+    MoveGenerator generator(board);
+    generator.generate_all_moves();
+    best_move = generator.get_all_moves().empty() ? move() : generator.get_all_moves()[0];
+    //nothing to think about
+    if (generator.get_all_moves().size() == 1 && !analyzing) {
+        best_move_time = 0;
+        overshoot = -1;
+        expected_length = 0;
+        return best_move;
+    }
 
+    bool time_limit = (time_manager.has_clock() || max_thinking_time > 0) && !analyzing;
+    int node_limit = analyzing ? 0 : max_nodes;
+    int depth_limit = analyzing ? ANALYSIS_MAX_DEPTH : max_search_depth;
+    if (nps > 0 && time_limit) {
+        int budget = (int) ((double) time_manager.get_hard_limit() * nps / 1000);
+        budget = budget < 1 ? 1 : budget;
+        if (node_limit == 0 || budget < node_limit) {
+            node_limit = budget;
+        }
+    }
+    //the clock only decides between the iterations with nps
+    bool time_iterations = time_limit && (max_nodes == 0 || nps > 0);
+    if (node_limit > 0) {
+        time_limit = false;
+    }
+    search_threads = node_limit > 0 ? 1 : threads;
+
+    main_thread.set_position(*board);
+    main_thread.reset(&stop_search, node_limit);
+    deadline = start_time + time_manager.get_hard_limit();
+    //the timer starts after the first iteration, a ponder search gets its
+    //clock from ponder_hit()
+    bool timer_started = false;
 #ifdef USE_HASH_TABLE
-            best = moves[index];
+    hash_table.new_search();
 #endif
-            pv_search = false;
+    start_helpers();
+
+    if (!xboard && show_thinking) {
+        cout << "ply  score   time   nodes re  pv\n";
+    }
 
-            // store the new, better alpha node in the path
-            board->pv[board->ply][board->ply] = moves[index];
-            for (int j = board->ply + 1; j < board->pv_length[board->ply + 1]; ++j) {
-                board->pv[board->ply][j] = board->pv[board->ply + 1][j];
+    int depth = 1;
+    bool hit = predicted_reply();
+    if (hit) {
+        main_thread.pv_length = expected_length - 2;
+        for (int j = 0; j < main_thread.pv_length; j++) {
+            main_thread.pv[j] = expected_line[j + 2];
+        }
+        best_move = main_thread.pv[0];
+        //the previous search got that deep below the reply
+        if (expected_depth > 3) {
+            depth = expected_depth - 2;
+            best_score = expected_score;
+        }
+        predicted_searches++;
+    }
+    int start_depth = depth;
+    total_searches++;
+
+    for (; depth <= depth_limit && !main_thread.time_exit; depth++) {
+        current_depth = depth;
+        int iteration_start = get_ms();
+        int iteration_nodes = get_checked_nodes();
+        int score = main_thread.aspiration_search(depth, best_score);
+        if (depth >= ASPIRATION_MIN_DEPTH) {
+            aspiration_iterations++;
+            aspiration_researches += main_thread.researches;
+        }
+        if (main_thread.time_exit || main_thread.root_best.move == 0) {
+            break;
+        }
+        //remember when we found the move that we are going to play
+        bool best_move_changed = finished_depth == 0 || !(best_move == main_thread.pv[0]);
+        if (best_move_changed) {
+            best_move_time = get_ms() - start_time;
+        }
+        best_move = main_thread.pv[0];
+        best_move_plys = main_thread.pv_length;
+        best_score = score;
+        //the skipped iterations are reached now as well
+        for (int d = finished_depth + 1; d <= depth && d < MAX_PLY; d++) {
+            depth_time[d] += get_ms() - start_time;
+            depth_count[d]++;
+        }
+        finished_depth = depth;
+        //there is a searched move now, the deadline may have passed already
+        if (time_limit && !pondering && !timer_started) {
+            timer.start(deadline, &stop_search);
+            timer_started = true;
+        }
+
+        //the next best moves of the root with multi-PV
+        int lines = multi_pv > 1 ? search_other_lines(depth, score,
+                generator.get_all_moves().size()) : 0;
+
+        if (show_thinking) {
+            print_line(depth, score, main_thread.pv, main_thread.pv_length, start_time);
+            for (int l = 1; l < lines; l++) {
+                print_line(depth, multi_score[l], multi_lines[l], multi_length[l], start_time);
             }
-            board->pv_length[board->ply] = board->pv_length[board->ply + 1];
         }
+        if (abs(score) >= MATE) {
+            break;
+        }
+        if (time_iterations && !pondering && !time_manager.next_iteration(
+                elapsed_time(clock_start, 0), elapsed_time(iteration_start, iteration_nodes),
+                best_move_changed, score)) {
+            break;
+        }
+    }
+    //we can't move before the opponent did, and the analysis only ends on
+    //the next command
+    while ((pondering || analyzing) && !stop_search) {
+        usleep(1000);
     }
 
-    // if we didn't played a move, we are either checkmate or stalemate
-    if (!played_move) {
-        if (check) {
-            return -(MATE + board->ply);
+    stop_helpers();
+    timer.stop();
+    overshoot = time_limit && main_thread.time_exit ? get_ms() - deadline : -1;
+
+    //keep the line for the next move of the game
+    if (finished_depth > 0) {
+        expected_length = main_thread.pv_length;
+        for (int j = 0; j < expected_length; j++) {
+            expected_line[j] = main_thread.pv[j];
         }
-        return DRAW;
+        expected_depth = finished_depth;
+        expected_score = best_score;
+        expected_history_size = board->history.size();
+    } else {
+        expected_length = 0;
     }
 
-    if (board->fifty_moves >= FIFTY_MOVES_RULE) {
-        return DRAW;
+#ifdef SHOW_SEARCH_INFO
+    if (!xboard) {
+        float total_time = (float) (get_ms() - start_time) / 1000;
+        int nodes = get_checked_nodes();
+        printf("%s nodes searched in %.2f secs (%.1fK nodes/sec), ",
+                display_nodes_count(nodes), total_time,
+                (nodes / 1000.0) / total_time);
+        printf("%.1f%% in quiescence", get_quiescence_nodes() * 100.0 / (nodes + 1));
+        printf(", %.1f%% cutoffs on the first move",
+                get_first_move_cutoffs() * 100.0 / (get_beta_cutoffs() + 1));
+        if (threads > 1) {
+            printf(", %d threads (%s)", threads,
+                    parallel_search == SMP_SPLIT_POINTS ? "split points" : "lazy SMP");
+        }
+        printf("\n");
+        if (hit) {
+            printf("Predicted reply, started at depth %d\n", start_depth);
+        }
     }
-#ifdef USE_HASH_TABLE
-    htype type = (alpha == o_alpha) ? UPPER : EXACT;
-    if (alpha != o_alpha) {
-        // TODO: change PV
+#endif
+
+    if (!xboard && show_best_score) {
+        cout << "Score for move " << move_to_algebraic(best_move, *board) << " is ";
+        cout << display_score(best_score) << " (" << best_move_plys << " plys)";
+        cout << endl;
     }
-    board->hash_store(depth, type, alpha, best);
-#endif // USE_HASH_TABLE
-    return alpha;
+    return best_move;
 }
 
-int ComputerPlayer::quiescence(int alpha, int beta) {
+/*
+ * Monte Carlo tree search instead of alpha-beta, with all the threads running
+ * playouts on the same tree. The limits are the same as for search_pv(), but
+ * a node limit counts the playouts, and without a time or node limit the
+ * search ends when the best line is max_search_depth moves long. It always
+ * ends when the tree is full. The best move is the one with the most visits.
+ */
+move ComputerPlayer::search_tree() {
+    int start_time = get_ms();
+    clock_start = start_time;
+    time_manager.start_move(board->history.size() / 2, max_thinking_time * 1000);
 
-    board->checked_nodes++;
+    MoveGenerator generator(board);
+    generator.generate_all_moves();
+    vector<move>& moves = generator.get_all_moves();
+    move best_move = moves.empty() ? move() : moves[0];
+    expected_length = 0;
+    if (moves.size() == 1 && !analyzing) {
+        best_move_time = 0;
+        overshoot = -1;
+        return best_move;
+    }
 
-    // check the time every 4096 nodes
-    if ((board->checked_nodes & 4095) == 0) {
-        if (get_ms() > board->stop_time) {
-            board->time_exit = true;
-            return 0;
+    bool time_limit = (time_manager.has_clock() || max_thinking_time > 0) && !analyzing;
+    int playout_limit = analyzing ? 0 : max_nodes;
+    int depth_limit = analyzing ? ANALYSIS_MAX_DEPTH : max_search_depth;
+    if (nps > 0 && time_limit) {
+        int budget = (int) ((double) time_manager.get_hard_limit() * nps / 1000);
+        budget = budget < 1 ? 1 : budget;
+        if (playout_limit == 0 || budget < playout_limit) {
+            playout_limit = budget;
         }
     }
+    if (playout_limit > 0) {
+        time_limit = false;
+    }
+    search_threads = playout_limit > 0 ? 1 : threads;
 
-    board->pv_length[board->ply] = board->ply;
-
-    // check with the evaluation function
-    int e = evaluate(board);
-    if (e >= beta) {
-        return beta;
+    main_thread.set_position(*board);
+    main_thread.reset(&stop_search);
+    if (!tree.set_root(main_thread)) {
+        return search_pv();
     }
-    if (e > alpha) {
-        alpha = e;
+    deadline = start_time + time_manager.get_hard_limit();
+    if (time_limit && !pondering) {
+        timer.start(deadline, &stop_search);
     }
+#ifdef USE_HASH_TABLE
+    hash_table.new_search();
+#endif
+    start_helpers();
 
-    MoveGenerator generator(board);
-    generator.generate_all_moves();
-    vector<move> moves;
-    generator.get_all_capture_moves(moves);
-
-    for (vector<move>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
-        board->fake_move(*it);
-        int score = -quiescence(-beta, -alpha);
-        board->unfake_move();
-        if (score > alpha) {
-            if (score >= beta) {
-                return beta;
+    if (!xboard && show_thinking) {
+        cout << "ply  score   time   nodes re  pv\n";
+    }
+    move line[MAX_PLY];
+    int length = 0;
+    int printed = start_time;
+    best_move_time = 0;
+    while (!stop_search) {
+        //leaves of a full tree are never expanded, more playouts only make
+        //their evaluations look more certain than they are
+        if (tree.is_full()) {
+            if (!pondering && !analyzing) {
+                break;
             }
-            alpha = score;
+            usleep(1000);
+            continue;
+        }
+        for (int i = 0; i < MCTS_BATCH && !stop_search; i++) {
+            tree.playout(main_thread);
+        }
+        length = tree.principal_variation(line, MAX_PLY);
+        if (length > 0 && !(line[0] == best_move)) {
+            best_move = line[0];
+            best_move_time = get_ms() - start_time;
+            printed = 0;
+        }
+        current_depth = length;
+        if (show_thinking && length > 0 && get_ms() - printed >= 1000) {
+            print_line(length, tree.score(), line, length, start_time);
+            printed = get_ms();
+        }
+        if (pondering || analyzing) {
+            continue;
+        }
+        if (playout_limit > 0 && tree.get_playouts() >= playout_limit) {
+            break;
+        }
+        if (time_limit && elapsed_time(clock_start, 0) >= time_manager.get_soft_limit()) {
+            break;
+        }
+        if (!time_limit && playout_limit == 0 && length >= depth_limit) {
+            break;
+        }
+    }
 
-            // store the new, better alpha node in the path
-            board->pv[board->ply][board->ply] = *it;
-            for (int j = board->ply + 1; j < board->pv_length[board->ply + 1]; ++j) {
-                board->pv[board->ply][j] = board->pv[board->ply + 1][j];
-            }
-            board->pv_length[board->ply] = board->pv_length[board->ply + 1];
+    stop_helpers();
+    timer.stop();
+    overshoot = time_limit && stop_search ? get_ms() - deadline : -1;
+    if (overshoot < 0) {
+        overshoot = -1;
+    }
+    length = tree.principal_variation(line, MAX_PLY);
+    if (length > 0) {
+        best_move = line[0];
+        if (show_thinking) {
+            print_line(length, tree.score(), line, length, start_time);
         }
+        //the reply of the line is the ponder move
+        expected_length = length;
+        for (int j = 0; j < length; j++) {
+            expected_line[j] = line[j];
+        }
+        expected_depth = 0;
+        expected_score = tree.score();
+        expected_history_size = board->history.size();
     }
-    return alpha;
-}
 
-void ComputerPlayer::sort_pv(vector<move>& moves) {
-    board->follow_pv = false;
-    for (unsigned i = 0; i < moves.size(); i++) {
-        if (moves[i] == board->pv[0][board->ply]) {
-            board->follow_pv = true;
-            move tmp = moves[0];
-            moves[0] = moves[i];
-            moves[i] = tmp;
-            return;
+#ifdef SHOW_SEARCH_INFO
+    if (!xboard) {
+        float total_time = (float) (get_ms() - start_time) / 1000;
+        int nodes = get_checked_nodes();
+        printf("%s nodes searched in %.2f secs (%.1fK nodes/sec), ",
+                display_nodes_count(nodes), total_time,
+                (nodes / 1000.0) / total_time);
+        printf("%d playouts (%.1fK/sec), %d nodes in the tree, %d visits kept",
+                tree.get_playouts(), tree.get_playouts() / 1000.0 / total_time,
+                tree.get_size(), tree.get_reused());
+        if (threads > 1) {
+            printf(", %d threads", search_threads);
         }
+        printf("\n");
     }
+#endif
+
+    if (!xboard && show_best_score) {
+        cout << "Score for move " << move_to_algebraic(best_move, *board) << " is ";
+        cout << display_score(tree.score()) << " (" << length << " plys)";
+        cout << endl;
+    }
+    return best_move;
 }
+
+/*
+ * Average time to reach each depth over all the searches of this player.
+ */
+void ComputerPlayer::print_statistics() {
+    if (total_searches == 0) {
+        return;
+    }
+    printf("---- %s: %d searches, %d predicted replies ----\n", name.c_str(),
+            total_searches, predicted_searches);
+    printf("%d aspiration re-searches in %d iterations (%.2f per iteration)\n",
+            aspiration_researches, aspiration_iterations,
+            aspiration_researches / (aspiration_iterations + 0.0001));
+    printf("depth  searches  avg time to depth\n");
+    for (int d = 1; d < MAX_PLY && depth_count[d] > 0; d++) {
+        printf("%5d %9d %11.3f secs\n", d, depth_count[d],
+                depth_time[d] / 1000.0 / depth_count[d]);
+    }
+}
+
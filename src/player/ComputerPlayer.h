@@ -16,21 +16,140 @@
 
 #include <memory.h>
 #include <time.h>
+#include <pthread.h>
 #include "Player.h"
 #include "../model/OpeningBook.h"
 #include "../model/evaluate.h"
+#include "../model/HashTable.h"
+#include "../model/Tablebase.h"
+#include "SearchThread.h"
+#include "MonteCarloTree.h"
+#include "TimeManager.h"
+#include "SearchTimer.h"
 
 class ComputerPlayer : public Player {
 public:
     ComputerPlayer(bool use_opening_book = true);
+    ~ComputerPlayer();
     move get_move();
+    int get_best_move_time();
+    //ms between the deadline and the end of the last search, -1 if the
+    //search finished before the deadline
+    int get_overshoot();
+    //nodes of the last search
+    int get_checked_nodes();
+    int get_quiescence_nodes();
+    int get_beta_cutoffs();
+    int get_first_move_cutoffs();
+    //playouts of the last Monte Carlo tree search
+    int get_playouts();
+    void print_statistics();
+    //clock of the game (ms), without it every move gets max_thinking_time
+    void set_level(int moves, int base, int increment);
+    void set_time(int remaining);
+    void set_opponent_time(int remaining);
+    //the clock counts nodes instead of ms, at that many nodes per second
+    //(0 is the real clock).. the search only stops on the node count then
+    void set_nps(int nodes);
+
+    //pondering: right after our move the expected reply of the opponent is
+    //played on a copy of the board and searched in the background, without a
+    //clock. Returns false if there is nothing to ponder on
+    bool start_pondering();
+    bool is_pondering();
+    move get_ponder_move();
+    //the opponent played the ponder move: the search goes on with the clock
+    //of this move and its result is returned
+    move ponder_hit();
+    //any other move (or command).. the search is thrown away
+    void stop_pondering();
+    //stops the running search (called from another thread), get_move()
+    //returns the best move found so far. A ponder search goes on
+    void move_now();
+    //analysis: no limits at all, the search runs until it's stopped
+    void set_analyze(bool analyze);
+    //"stat01" line of xboard for the running search
+    void print_status();
 private:
     bool use_opening_book;
+    int best_move_time;
+    int overshoot;
+    //kept between the moves of a game
+    SearchThread main_thread;
+    //lazy SMP: the helpers search the same position and only share the
+    //transposition table and the stop flag with the main thread.
+    //split points: the helpers search the moves of the split points of the
+    //other threads of the team
+    vector<SearchThread*> helpers;
+    pthread_t helper_threads[MAX_THREADS];
+    SearchTeam team;
+    //Monte Carlo tree search: all the threads run playouts on it, the tree is
+    //kept between the moves
+    MonteCarloTree tree;
+    volatile bool stop_search;
+    //threads of the current search, searches with a node limit only use the
+    //main thread so they can be repeated
+    int search_threads;
+    int nps;
+    //start of the clock of the move and the hard limit in get_ms() time,
+    //both set again on a ponder hit
+    volatile int clock_start;
+    int deadline;
+    TimeManager time_manager;
+    SearchTimer timer;
+
+    //searching the ponder move without a clock
+    volatile bool pondering;
+    //the ponder search is started on the thread of the last search and
+    //stopped on the input thread, the lock keeps the thread and the board
+    //consistent between them
+    pthread_mutex_t ponder_lock;
+    bool ponder_running;
+    pthread_t ponder_thread;
+    move ponder_move;
+    move ponder_result;
+    Board ponder_board;
+    Board* game_board;
+
+    volatile bool analyzing;
+    //iteration of the running search
+    volatile int current_depth;
+
+    //lines of multi-PV from the last iteration, the best one first
+    move multi_lines[MAX_MULTI_PV][MAX_PLY];
+    int multi_length[MAX_MULTI_PV];
+    int multi_score[MAX_MULTI_PV];
+
+    //PV of the previous search, used if the opponent plays the expected reply
+    move expected_line[MAX_PLY];
+    int expected_length;
+    int expected_depth;
+    int expected_score;
+    unsigned expected_history_size;
+
+    //time to depth over the whole game
+    int total_searches;
+    int predicted_searches;
+    //iterations with an aspiration window, and how many had to be searched again
+    int aspiration_iterations;
+    int aspiration_researches;
+    int depth_time[MAX_PLY];
+    int depth_count[MAX_PLY];
+
     OpeningBook opening_book;
     move search_pv();
-    int alpha_beta(int depth, int alpha, int beta);
-    int quiescence(int alpha, int beta);
-    void sort_pv(vector<move>& moves);
+    move search_tree();
+    //ms since start_time (or since start_nodes with nps)
+    int elapsed_time(int start_time, int start_nodes);
+    static void* run_ponder(void* data);
+    //start_pondering() and stop_pondering() with the lock held
+    bool begin_pondering();
+    void end_pondering();
+    int search_other_lines(int depth, int score, int root_moves);
+    void print_line(int depth, int score, const move* line_moves, int length, int start_time);
+    bool predicted_reply();
+    void start_helpers();
+    void stop_helpers();
 };
 
 #endif /* COMPUTERPLAYER_H_ */
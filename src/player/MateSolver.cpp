@@ -0,0 +1,370 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#include "MateSolver.h"
+
+//entries per bucket of the table
+#define MATE_BUCKET 4
+
+MateSolver::MateSolver(int megabytes) : mate_in(0), shortest(false), proof_size(0),
+complete(false), nodes(0), time(0), first_nodes(0), first_time(0), node_limit(0),
+aborted(false) {
+    table_size = MATE_BUCKET;
+    while ((table_size << 1) * sizeof (mate_entry) <= ((unsigned) megabytes << 20)) {
+        table_size <<= 1;
+    }
+    table = new mate_entry[table_size];
+    memset(table, 0, table_size * sizeof (mate_entry));
+}
+
+MateSolver::~MateSolver() {
+    delete[] table;
+}
+
+/*
+ * The entry of the position that is valid for so many plies, or NULL.
+ */
+mate_entry* MateSolver::lookup(u64 key, int plies) {
+    mate_entry* bucket = &table[key & (table_size - MATE_BUCKET)];
+    mate_entry* found = NULL;
+    for (int i = 0; i < MATE_BUCKET; i++) {
+        mate_entry* entry = &bucket[i];
+        if (entry->key != key) {
+            continue;
+        }
+        if ((entry->pn == 0 && entry->plies <= plies) || (entry->dn == 0 && entry->plies >= plies)) {
+            return entry;
+        }
+        if (entry->plies == plies) {
+            found = entry;
+        }
+    }
+    return found;
+}
+
+/*
+ * Replaces the entry of the same node, an empty one or the one with the least
+ * work.
+ */
+void MateSolver::store(u64 key, int plies, unsigned pn, unsigned dn, unsigned work,
+        int distance, int best) {
+    mate_entry* bucket = &table[key & (table_size - MATE_BUCKET)];
+    mate_entry* replace = NULL;
+    for (int i = 0; i < MATE_BUCKET; i++) {
+        if (bucket[i].key == key && bucket[i].plies == plies) {
+            replace = &bucket[i];
+            break;
+        }
+        if (replace == NULL || (replace->key != 0 && (bucket[i].key == 0
+                || bucket[i].work < replace->work))) {
+            replace = &bucket[i];
+        }
+    }
+    //a proof is valid for every node with at least that many plies
+    if (pn == 0) {
+        plies = distance;
+    }
+    replace->key = key;
+    replace->plies = plies;
+    replace->pn = pn;
+    replace->dn = dn;
+    replace->work = work;
+    replace->distance = distance;
+    replace->best = best;
+}
+
+/*
+ * Solves the node if the game is over or no plies are left. The attacker
+ * needs a move to mate, so it can't be mated or stalemated itself.
+ */
+bool MateSolver::leaf(u64 key, int plies, bool attacker, MoveGenerator& generator) {
+    if (generator.get_all_moves().empty()) {
+        if (!attacker && generator.king_under_check) {
+            store(key, plies, 0, PN_INFINITY, 0);
+        } else {
+            store(key, plies, PN_INFINITY, 0, 0);
+        }
+        return true;
+    }
+    if (plies == 0) {
+        store(key, plies, PN_INFINITY, 0, 0);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Proof and disproof numbers of a new node by the number of moves: a
+ * defender with less replies is easier to mate.
+ */
+void MateSolver::initialize_child(u64 key, int plies, bool attacker) {
+    if (lookup(key, plies) != NULL) {
+        return;
+    }
+    nodes++;
+    MoveGenerator generator(&board);
+    //no plies left: only a mate counts, and there is no mate without a check
+    if (plies == 0 && (attacker || !generator.check_for_check_simple())) {
+        store(key, plies, PN_INFINITY, 0, 0);
+        return;
+    }
+    generator.generate_all_moves();
+    if (leaf(key, plies, attacker, generator)) {
+        return;
+    }
+    unsigned count = generator.get_all_moves().size();
+    if (attacker) {
+        store(key, plies, 1, count, 0);
+    } else {
+        store(key, plies, count, 1, 0);
+    }
+}
+
+/*
+ * Multiple iterative deepening of df-pn: searches below the node until its
+ * proof number reaches pn_threshold or its disproof number dn_threshold.
+ */
+void MateSolver::mid(int plies, bool attacker, unsigned pn_threshold, unsigned dn_threshold) {
+    //every expansion counts too, so the node limit stops the search even if the
+    //table is too small to keep the children
+    nodes++;
+    int start_nodes = nodes;
+    u64 key = board.get_hash();
+    MoveGenerator generator(&board);
+    generator.generate_all_moves();
+    if (leaf(key, plies, attacker, generator)) {
+        return;
+    }
+    vector<move>& moves = generator.get_all_moves();
+    vector<u64> keys(moves.size());
+    for (unsigned i = 0; i < moves.size(); i++) {
+        board.fake_move(moves[i]);
+        keys[i] = board.get_hash();
+        initialize_child(keys[i], plies - 1, !attacker);
+        board.unfake_move();
+    }
+
+    while (true) {
+        //OR node: the smallest proof number and the sum of the disproof
+        //numbers.. AND node the other way around
+        unsigned pn = attacker ? PN_INFINITY : 0;
+        unsigned dn = attacker ? 0 : PN_INFINITY;
+        int best = -1;
+        unsigned best_value = PN_INFINITY;
+        unsigned second_value = PN_INFINITY;
+        int distance = 0;
+        int mating = 0;
+        for (unsigned i = 0; i < moves.size(); i++) {
+            unsigned child_pn = 1;
+            unsigned child_dn = 1;
+            int child_distance = 0;
+            mate_entry* entry = lookup(keys[i], plies - 1);
+            if (entry != NULL) {
+                child_pn = entry->pn;
+                child_dn = entry->dn;
+                child_distance = entry->distance;
+            }
+            unsigned value = attacker ? child_pn : child_dn;
+            if (best < 0 || value < best_value) {
+                second_value = best_value;
+                best_value = value;
+                best = i;
+            } else if (value < second_value) {
+                second_value = value;
+            }
+            if (attacker) {
+                dn += child_dn;
+                //the shortest mate
+                if (child_pn == 0 && (pn != 0 || child_distance < distance)) {
+                    distance = child_distance;
+                    mating = i;
+                }
+                pn = child_pn < pn ? child_pn : pn;
+            } else {
+                pn += child_pn;
+                dn = child_dn < dn ? child_dn : dn;
+                //the longest defence
+                distance = child_distance > distance ? child_distance : distance;
+            }
+        }
+        if (pn == 0) {
+            dn = PN_INFINITY;
+        } else if (dn == 0) {
+            pn = PN_INFINITY;
+        } else {
+            pn = pn < PN_INFINITY - 1 ? pn : PN_INFINITY - 1;
+            dn = dn < PN_INFINITY - 1 ? dn : PN_INFINITY - 1;
+        }
+        store(key, plies, pn, dn, nodes - start_nodes, distance + 1, mating);
+
+        if (pn >= pn_threshold || dn >= dn_threshold || aborted) {
+            break;
+        }
+        if (node_limit > 0 && nodes >= node_limit) {
+            aborted = true;
+            break;
+        }
+
+        //thresholds of the most proving child: it's searched until another
+        //child becomes better, or the node exceeds its own thresholds. It may
+        //get 25% above the second best child, so we don't jump between two
+        //children all the time (the 1+epsilon trick)
+        mate_entry* entry = lookup(keys[best], plies - 1);
+        unsigned child_pn = entry != NULL ? entry->pn : 1;
+        unsigned child_dn = entry != NULL ? entry->dn : 1;
+        unsigned sibling_threshold = PN_INFINITY;
+        if (second_value < PN_INFINITY / 2) {
+            sibling_threshold = second_value + second_value / 4 + 1;
+        }
+        unsigned child_pn_threshold;
+        unsigned child_dn_threshold;
+        if (attacker) {
+            child_pn_threshold = pn_threshold < sibling_threshold ? pn_threshold : sibling_threshold;
+            child_dn_threshold = dn_threshold >= PN_INFINITY ? PN_INFINITY : dn_threshold - dn + child_dn;
+        } else {
+            child_pn_threshold = pn_threshold >= PN_INFINITY ? PN_INFINITY : pn_threshold - pn + child_pn;
+            child_dn_threshold = dn_threshold < sibling_threshold ? dn_threshold : sibling_threshold;
+        }
+        board.fake_move(moves[best]);
+        mid(plies - 1, !attacker, child_pn_threshold, child_dn_threshold);
+        board.unfake_move();
+    }
+}
+
+/*
+ * Walks the proof tree and collects its nodes. Parts of it that were replaced
+ * in the table are proven again. Returns false if it's not possible within
+ * the node limit.
+ */
+bool MateSolver::collect_proof(int plies, bool attacker, set<u64>& visited) {
+    u64 key = board.get_hash();
+    if (visited.count(key) > 0) {
+        return true;
+    }
+    mate_entry* found = lookup(key, plies);
+    if (found == NULL || found->pn != 0) {
+        mid(plies, attacker, PN_INFINITY, PN_INFINITY);
+        found = lookup(key, plies);
+        if (found == NULL || found->pn != 0) {
+            return false;
+        }
+    }
+    //the table can change below
+    mate_entry entry = *found;
+    visited.insert(key);
+    if (entry.distance == 0) {
+        return true;
+    }
+    MoveGenerator generator(&board);
+    generator.generate_all_moves();
+    vector<move>& moves = generator.get_all_moves();
+    bool result = true;
+    for (unsigned i = 0; i < moves.size() && result; i++) {
+        if (attacker && i != entry.best) {
+            continue;
+        }
+        board.fake_move(moves[i]);
+        result = collect_proof(entry.distance - 1, !attacker, visited);
+        board.unfake_move();
+    }
+    return result;
+}
+
+/*
+ * The mating line: the mating moves of the attacker and the longest defence.
+ */
+void MateSolver::extract_line(int plies) {
+    line.clear();
+    bool attacker = true;
+    mate_entry* entry = lookup(board.get_hash(), plies);
+    while (entry != NULL && entry->pn == 0 && entry->distance > 0) {
+        MoveGenerator generator(&board);
+        generator.generate_all_moves();
+        vector<move>& moves = generator.get_all_moves();
+        int next_plies = entry->distance - 1;
+        move next = moves[0];
+        if (attacker) {
+            next = moves[entry->best];
+        } else {
+            int longest = -1;
+            for (unsigned i = 0; i < moves.size(); i++) {
+                board.fake_move(moves[i]);
+                mate_entry* child = lookup(board.get_hash(), next_plies);
+                if (child != NULL && child->pn == 0 && child->distance > longest) {
+                    longest = child->distance;
+                    next = moves[i];
+                }
+                board.unfake_move();
+            }
+        }
+        line.push_back(next);
+        board.fake_move(next);
+        attacker = !attacker;
+        entry = lookup(board.get_hash(), next_plies);
+    }
+    for (unsigned i = 0; i < line.size(); i++) {
+        board.unfake_move();
+    }
+}
+
+int MateSolver::solve(const Board& position, int max_moves, int limit, bool find_shortest) {
+    int start = get_ms();
+    board = position;
+    memset(table, 0, table_size * sizeof (mate_entry));
+    node_limit = limit;
+    aborted = false;
+    nodes = 0;
+    mate_in = 0;
+    shortest = false;
+    proof_size = 0;
+    complete = false;
+    line.clear();
+
+    u64 key = board.get_hash();
+    int plies = 2 * max_moves - 1;
+    mid(plies, true, PN_INFINITY, PN_INFINITY);
+    first_nodes = nodes;
+    first_time = get_ms() - start;
+    mate_entry* entry = lookup(key, plies);
+    if (entry == NULL || entry->pn != 0) {
+        time = first_time;
+        return aborted ? MATE_UNKNOWN : MATE_NOT_FOUND;
+    }
+
+    //the first proof is not always the shortest mate.. try to mate faster
+    //until it's disproven
+    int distance = entry->distance;
+    shortest = distance == 1;
+    while (find_shortest && !shortest && !aborted) {
+        mid(distance - 2, true, PN_INFINITY, PN_INFINITY);
+        entry = lookup(key, distance - 2);
+        if (entry != NULL && entry->pn == 0) {
+            distance = entry->distance;
+            shortest = distance == 1;
+        } else if (!aborted) {
+            shortest = true;
+        }
+    }
+    mate_in = (distance + 1) / 2;
+
+    //parts of the proof can be replaced already, they are proven again.. a
+    //table that is too small could do that forever without a budget
+    node_limit = nodes + (limit > 0 ? limit : MATE_SOLVER_NODES);
+    aborted = false;
+    set<u64> visited;
+    complete = collect_proof(distance, true, visited) && !aborted;
+    proof_size = visited.size();
+    extract_line(distance);
+    time = get_ms() - start;
+    return MATE_FOUND;
+}
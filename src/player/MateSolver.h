@@ -0,0 +1,106 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#ifndef MATESOLVER_H_
+#define MATESOLVER_H_
+
+#include <vector>
+#include <set>
+#include "../common/define.h"
+#include "../common/utils.h"
+#include "../model/Board.h"
+#include "../model/MoveGenerator.h"
+
+using std::vector;
+using std::set;
+
+//proof or disproof number of a solved node
+#define PN_INFINITY     100000000
+//results of MateSolver::solve()
+#define MATE_NOT_FOUND  0
+#define MATE_FOUND      1
+#define MATE_UNKNOWN    2
+
+/*
+ * Node of the proof tree in the table of the solver. The proof numbers are
+ * valid for plies plies left to the attacker, a proof also for more plies and
+ * a disproof also for less.
+ */
+typedef struct {
+    u64 key;
+    unsigned pn;
+    unsigned dn;
+    //nodes spent on the subtree, the cheapest entries are replaced first
+    unsigned work;
+    short plies;
+    //proven: plies to the mate, and the index of the mating move (attacker)
+    unsigned char distance;
+    unsigned char best;
+} mate_entry;
+
+/*
+ * Mate solver with the depth-first proof-number search (df-pn).
+ *
+ * The side to move is the attacker, it needs only one move to the mate (OR
+ * node), the defender has to be mated after all of its moves (AND node). The
+ * search always expands the most proving node below the thresholds, the
+ * proof and disproof numbers of the visited nodes are kept in a table of
+ * fixed size. "Mate in N" is searched with 2N - 1 plies.
+ */
+class MateSolver {
+public:
+    //size of the table in MB
+    MateSolver(int megabytes = DEFAULT_MATE_TABLE_SIZE);
+    ~MateSolver();
+
+    //proves or disproves a mate in at most max_moves moves, until node_limit
+    //nodes are searched (0 is no limit). With find_shortest the shorter mates
+    //are searched after the first proof, until they are disproven. Collecting
+    //the proof tree afterwards gets node_limit nodes again (MATE_SOLVER_NODES
+    //without a limit)
+    int solve(const Board& position, int max_moves, int node_limit = 0,
+            bool find_shortest = false);
+
+    //the mating line of the last successful solve()
+    vector<move> line;
+    //mate in so many moves.. and true if no shorter mate exists
+    int mate_in;
+    bool shortest;
+    //nodes of the proof tree (different positions), and false if the parts
+    //of it that were replaced in the table couldn't be proven again
+    int proof_size;
+    bool complete;
+    //searched nodes and the time in ms, in total and until the first proof
+    int nodes;
+    int time;
+    int first_nodes;
+    int first_time;
+
+private:
+    Board board;
+    mate_entry* table;
+    unsigned table_size;
+    int node_limit;
+    bool aborted;
+
+    mate_entry* lookup(u64 key, int plies);
+    void store(u64 key, int plies, unsigned pn, unsigned dn, unsigned work,
+            int distance = 0, int best = 0);
+    bool leaf(u64 key, int plies, bool attacker, MoveGenerator& generator);
+    void initialize_child(u64 key, int plies, bool attacker);
+    void mid(int plies, bool attacker, unsigned pn_threshold, unsigned dn_threshold);
+    bool collect_proof(int plies, bool attacker, set<u64>& visited);
+    void extract_line(int plies);
+};
+
+#endif /* MATESOLVER_H_ */
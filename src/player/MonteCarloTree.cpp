@@ -0,0 +1,377 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#include "MonteCarloTree.h"
+#include <cmath>
+
+using std::cerr;
+using std::endl;
+using std::pair;
+using std::make_pair;
+
+int mcts_memory = DEFAULT_MCTS_MEMORY;
+
+//chance to win of the side to move
+static double win_chance(int score) {
+    return 1.0 / (1.0 + exp(-score / MCTS_SCORE_SCALE));
+}
+
+MonteCarloTree::MonteCarloTree() : nodes(NULL), capacity(0), half(0), root(-1), root_hash(0),
+playouts(0), reused(0) {
+    start[0] = start[1] = 0;
+    used[0] = used[1] = 0;
+}
+
+MonteCarloTree::~MonteCarloTree() {
+    free(nodes);
+}
+
+/*
+ * The pool is only allocated by the first search, the pages are used as the
+ * tree grows.
+ */
+bool MonteCarloTree::allocate_pool() {
+    int megabytes = mcts_memory < 1 ? DEFAULT_MCTS_MEMORY : mcts_memory;
+    capacity = (int) ((((u64) megabytes << 20) / 2) / sizeof (mcnode));
+    nodes = (mcnode*) malloc((size_t) capacity * 2 * sizeof (mcnode));
+    if (nodes == NULL) {
+        cerr << "Not enough memory for a Monte Carlo tree of " << megabytes << " MB." << endl;
+        capacity = 0;
+        return false;
+    }
+    start[0] = 0;
+    start[1] = capacity;
+    return true;
+}
+
+//first of count nodes in the current half, -1 if it's full
+int MonteCarloTree::allocate(int count) {
+    if (used[half] + count > capacity) {
+        return -1;
+    }
+    int first = __sync_fetch_and_add(&used[half], count);
+    if (first + count > capacity) {
+        return -1;
+    }
+    return start[half] + first;
+}
+
+void MonteCarloTree::init_node(mcnode& node, move m, float prior) {
+    node.m = m;
+    node.prior = prior;
+    node.visits = 0;
+    node.virtual_loss = 0;
+    node.value = 0;
+    node.children = -1;
+    node.child_count = 0;
+    node.state = MC_LEAF;
+    node.result = 0;
+}
+
+int MonteCarloTree::find_child(int index, const move& m) {
+    mcnode& node = nodes[index];
+    if (node.state != MC_EXPANDED) {
+        return -1;
+    }
+    for (int i = 0; i < node.child_count; i++) {
+        if (is_same_move(nodes[node.children + i].m, m)) {
+            return node.children + i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Copies the node and everything below it into the current half.
+ */
+int MonteCarloTree::copy_subtree(int index) {
+    int copy = allocate(1);
+    nodes[copy] = nodes[index];
+    vector<pair<int, int> > pending;
+    pending.push_back(make_pair(index, copy));
+    while (!pending.empty()) {
+        int from = pending.back().first;
+        int to = pending.back().second;
+        pending.pop_back();
+        if (nodes[from].children < 0) {
+            continue;
+        }
+        int count = nodes[from].child_count;
+        int children = allocate(count);
+        nodes[to].children = children;
+        for (int i = 0; i < count; i++) {
+            nodes[children + i] = nodes[nodes[from].children + i];
+            pending.push_back(make_pair(nodes[from].children + i, children + i));
+        }
+    }
+    return copy;
+}
+
+/*
+ * The root is found among the nodes of the last search by the last two moves
+ * of the board, otherwise a new tree starts. The root is always expanded.
+ */
+bool MonteCarloTree::set_root(SearchThread& thread) {
+    if (nodes == NULL && !allocate_pool()) {
+        return false;
+    }
+    Board& board = thread.board;
+    unsigned size = board.history.size();
+    int found = -1;
+    if (root >= 0) {
+        if (board.get_hash() == root_hash) {
+            found = root;
+        } else if (size >= 1 && board.history[size - 1].previous_hash == root_hash) {
+            found = find_child(root, board.history[size - 1].m);
+        } else if (size >= 2 && board.history[size - 2].previous_hash == root_hash) {
+            found = find_child(root, board.history[size - 2].m);
+            if (found >= 0) {
+                found = find_child(found, board.history[size - 1].m);
+            }
+        }
+    }
+
+    half ^= 1;
+    used[half] = 0;
+    reused = 0;
+    if (found >= 0 && nodes[found].state == MC_EXPANDED) {
+        reused = nodes[found].visits;
+        root = copy_subtree(found);
+    } else {
+        move none;
+        none.move = 0;
+        root = allocate(1);
+        init_node(nodes[root], none, 1);
+    }
+    root_hash = board.get_hash();
+    playouts = 0;
+    if (nodes[root].state == MC_LEAF) {
+        expand(root, thread);
+    }
+    return true;
+}
+
+/*
+ * PUCT with the virtual losses of the running playouts. An unvisited move gets
+ * the value of its parent, a bit lower.
+ */
+int MonteCarloTree::select(int index) {
+    mcnode& node = nodes[index];
+    int parent_visits = node.visits + node.virtual_loss;
+    double explore = MCTS_CPUCT * sqrt((double) parent_visits + 1);
+    double first_play = 0.5;
+    if (node.visits > 0) {
+        first_play = 1 - (double) node.value / MC_UNIT / node.visits - MCTS_FPU_REDUCTION;
+    }
+    int best = node.children;
+    double best_value = -1;
+    for (int i = 0; i < node.child_count; i++) {
+        mcnode& child = nodes[node.children + i];
+        int visits = child.visits + child.virtual_loss;
+        double q = visits > 0 ? (double) child.value / MC_UNIT / visits : first_play;
+        double value = q + explore * child.prior / (1 + visits);
+        if (value > best_value) {
+            best_value = value;
+            best = node.children + i;
+        }
+    }
+    return best;
+}
+
+/*
+ * Adds the children of the node, or marks it as the end of the game (mate,
+ * stalemate, a repetition, fifty moves or an ending of the tablebases). The
+ * priors are a softmax of the evaluation after the move, where a piece that
+ * can be won by the opponent is lost already.
+ * The children are only added after a few visits of the leaf, with the
+ * children of every leaf the tree would be full in a few seconds.
+ */
+void MonteCarloTree::expand(int index, SearchThread& thread) {
+    mcnode& node = nodes[index];
+    Board& board = thread.board;
+    if (index != root) {
+        if (board.fifty_moves >= FIFTY_MOVES_RULE || repetitions(&board)) {
+            node.result = 1;
+            node.state = MC_TERMINAL;
+            return;
+        }
+#ifdef USE_TABLEBASES
+        int score;
+        if (board.pieces <= TB_MAX_PIECES && tablebases.probe(board, 0, score)) {
+            node.result = score > 0 ? 2 : (score < 0 ? 0 : 1);
+            node.state = MC_TERMINAL;
+            return;
+        }
+#endif
+    }
+
+    MoveGenerator generator(&board);
+    generator.generate_all_moves();
+    vector<move>& moves = generator.get_all_moves();
+    if (moves.empty()) {
+        node.result = generator.king_under_check ? 0 : 1;
+        node.state = MC_TERMINAL;
+        return;
+    }
+    int children = node.visits >= MCTS_EXPAND_VISITS || index == root ? allocate(moves.size()) : -1;
+    if (children < 0) {
+        node.state = MC_LEAF;
+        return;
+    }
+
+    double logits[MAX_MOVES];
+    double highest = 0;
+    for (unsigned i = 0; i < moves.size(); i++) {
+        const move& m = moves[i];
+        int gain = exchange_values[abs(m.content)];
+        if (m.special == MOVE_PROMOTION) {
+            gain += exchange_values[abs(m.promoted)] - PAWN_VALUE;
+        }
+        int lost = gain - generator.static_exchange(m);
+        board.fake_move(m);
+        logits[i] = (-evaluate(&board) - lost) / MCTS_PRIOR_SCALE;
+        board.unfake_move();
+        if (i == 0 || logits[i] > highest) {
+            highest = logits[i];
+        }
+    }
+    double sum = 0;
+    for (unsigned i = 0; i < moves.size(); i++) {
+        logits[i] = exp(logits[i] - highest);
+        sum += logits[i];
+    }
+    for (unsigned i = 0; i < moves.size(); i++) {
+        init_node(nodes[children + i], moves[i], (float) (logits[i] / sum));
+    }
+    node.children = children;
+    node.child_count = moves.size();
+    __sync_synchronize();
+    node.state = MC_EXPANDED;
+}
+
+/*
+ * One walk from the root to a leaf and back. The result is only counted if
+ * the quiescence search of the leaf was not stopped.
+ */
+bool MonteCarloTree::playout(SearchThread& thread) {
+    if (root < 0) {
+        return false;
+    }
+    int line[MCTS_MAX_DEPTH + 1];
+    int length = 0;
+    int index = root;
+    line[length++] = root;
+    while (length <= MCTS_MAX_DEPTH) {
+        mcnode& node = nodes[index];
+        if (node.state == MC_LEAF && __sync_bool_compare_and_swap(&node.state, MC_LEAF, MC_EXPANDING)) {
+            expand(index, thread);
+        }
+        if (node.state != MC_EXPANDED) {
+            break;
+        }
+        index = select(index);
+        __sync_fetch_and_add(&nodes[index].virtual_loss, 1);
+        thread.make_move(nodes[index].m);
+        line[length++] = index;
+    }
+
+    mcnode& leaf = nodes[index];
+    //the root is never evaluated, there is nothing played before it
+    bool counted = length > 1 || leaf.state == MC_TERMINAL;
+    double result;
+    if (leaf.state == MC_TERMINAL) {
+        result = leaf.result / 2.0;
+    } else {
+        result = counted ? win_chance(thread.quiescence(-EVALUATION_START, EVALUATION_START)) : 0;
+        counted = counted && !thread.time_exit;
+    }
+
+    //every node counts the result for the side that moved into it
+    for (int i = length - 1; i >= 0; i--) {
+        mcnode& node = nodes[line[i]];
+        result = 1 - result;
+        if (counted) {
+            __sync_fetch_and_add(&node.visits, 1);
+            __sync_fetch_and_add(&node.value, (long long) (result * MC_UNIT));
+        }
+        if (i > 0) {
+            __sync_fetch_and_sub(&node.virtual_loss, 1);
+            thread.unmake_move();
+        }
+    }
+    if (counted) {
+        __sync_fetch_and_add(&playouts, 1);
+    }
+    return counted;
+}
+
+void MonteCarloTree::run(SearchThread& thread) {
+    while (!*thread.stop && !is_full()) {
+        playout(thread);
+    }
+}
+
+int MonteCarloTree::best_child(int index) {
+    mcnode& node = nodes[index];
+    if (node.state != MC_EXPANDED) {
+        return -1;
+    }
+    int best = -1;
+    for (int i = 0; i < node.child_count; i++) {
+        int child = node.children + i;
+        if (nodes[child].visits > 0 && (best < 0 || nodes[child].visits > nodes[best].visits)) {
+            best = child;
+        }
+    }
+    return best;
+}
+
+int MonteCarloTree::principal_variation(move* line, int max_length) {
+    int length = 0;
+    int index = root < 0 ? -1 : best_child(root);
+    while (index >= 0 && length < max_length) {
+        line[length++] = nodes[index].m;
+        index = best_child(index);
+    }
+    return length;
+}
+
+int MonteCarloTree::score() {
+    int best = root < 0 ? -1 : best_child(root);
+    if (best < 0) {
+        return 0;
+    }
+    double chance = (double) nodes[best].value / MC_UNIT / nodes[best].visits;
+    if (chance < 0.001) {
+        chance = 0.001;
+    } else if (chance > 0.999) {
+        chance = 0.999;
+    }
+    return (int) (MCTS_SCORE_SCALE * log(chance / (1 - chance)));
+}
+
+int MonteCarloTree::get_playouts() {
+    return playouts;
+}
+
+int MonteCarloTree::get_reused() {
+    return reused;
+}
+
+int MonteCarloTree::get_size() {
+    return used[half] < capacity ? used[half] : capacity;
+}
+
+bool MonteCarloTree::is_full() {
+    return used[half] + MAX_MOVES > capacity;
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#ifndef MONTECARLOTREE_H_
+#define MONTECARLOTREE_H_
+
+#include "../common/define.h"
+#include "../common/utils.h"
+#include "../model/Board.h"
+#include "../model/MoveGenerator.h"
+#include "SearchThread.h"
+
+//states of a node
+#define MC_LEAF       0
+#define MC_EXPANDING  1
+#define MC_EXPANDED   2
+#define MC_TERMINAL   3
+
+//results are counted in thousandths of a win
+#define MC_UNIT    1000
+
+/*
+ * Node of the tree. The value is the sum of the results of its playouts from
+ * the view of the side that played the move, 1 is a win. A running playout
+ * adds a virtual loss to the nodes of its line, so the other threads prefer
+ * other lines meanwhile.
+ */
+typedef struct {
+    move m;
+    float prior;
+    volatile int visits;
+    volatile int virtual_loss;
+    volatile long long value;
+    //the children are next to each other in the pool, -1 if there are none
+    int children;
+    unsigned short child_count;
+    volatile char state;
+    //result of a terminal node for the side to move, in half points
+    char result;
+} mcnode;
+
+//memory of the tree in MB (-mcts-memory)
+extern int mcts_memory;
+
+/*
+ * Tree of the Monte Carlo tree search.
+ *
+ * Every playout walks down the tree by PUCT, expands the leaf with all its
+ * moves (the priors come from the evaluation after the move and the static
+ * exchange of the moved piece) and scores it with the quiescence search of
+ * the thread, turned into the chance to win by a sigmoid. Many threads run
+ * playouts on the same tree without locks.
+ *
+ * The nodes come from a pool of a fixed size, which is split in two halves.
+ * When the next search starts in a position of the tree (after our move and
+ * the reply) its subtree is copied into the other half and the rest is
+ * dropped. Without free nodes the tree doesn't grow anymore, the playouts go
+ * on at the leaves.
+ */
+class MonteCarloTree {
+public:
+    MonteCarloTree();
+    ~MonteCarloTree();
+
+    //the position of the board of the thread becomes the root, false if
+    //there is no memory for the tree
+    bool set_root(SearchThread& thread);
+    //false if the playout was stopped
+    bool playout(SearchThread& thread);
+    //playouts of a helper thread until it's stopped or the tree is full
+    void run(SearchThread& thread);
+
+    //most visited line from the root
+    int principal_variation(move* line, int max_length);
+    //score of the best move in centipawns
+    int score();
+    //since set_root()
+    int get_playouts();
+    //visits of the root that were kept from the last search
+    int get_reused();
+    int get_size();
+    bool is_full();
+
+private:
+    mcnode* nodes;
+    int capacity;
+    //first node and the used nodes of each half
+    int start[2];
+    volatile int used[2];
+    int half;
+    int root;
+    u64 root_hash;
+    volatile int playouts;
+    int reused;
+
+    bool allocate_pool();
+    int allocate(int count);
+    void init_node(mcnode& node, move m, float prior);
+    int find_child(int index, const move& m);
+    int copy_subtree(int index);
+    int select(int index);
+    int best_child(int index);
+    void expand(int index, SearchThread& thread);
+};
+
+#endif /* MONTECARLOTREE_H_ */
@@ -14,8 +14,9 @@
 #include "Player.h"
 
 Player::Player() : name("unknown"), max_thinking_time(DEFAULT_THINKING_TIME),
-max_search_depth(MAX_SEARCH_DEPTH), show_best_score(false),
-show_thinking(false), xboard(false) {
+max_search_depth(MAX_SEARCH_DEPTH), max_nodes(0), show_best_score(false),
+show_thinking(false), multi_pv(1), xboard(false), threads(1),
+parallel_search(SMP_LAZY) {
 }
 
 Player::~Player() {
@@ -37,6 +38,10 @@ void Player::set_max_search_depth(int depth) {
     max_search_depth = depth;
 }
 
+void Player::set_max_nodes(int nodes) {
+    max_nodes = nodes < 0 ? 0 : nodes;
+}
+
 void Player::set_show_best_score(bool show) {
     show_best_score = show;
 }
@@ -45,6 +50,21 @@ void Player::set_show_thinking(bool show) {
     show_thinking = show;
 }
 
+void Player::set_multi_pv(int lines) {
+    multi_pv = lines < 1 ? 1 : (lines > MAX_MULTI_PV ? MAX_MULTI_PV : lines);
+}
+
 void Player::set_xboard(bool value) {
     xboard = value;
 }
+
+void Player::set_threads(int count) {
+    threads = count < 1 ? 1 : (count > MAX_THREADS ? MAX_THREADS : count);
+}
+
+void Player::set_parallel_search(int algorithm) {
+    parallel_search = algorithm;
+}
+
+void Player::print_statistics() {
+}
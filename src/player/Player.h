@@ -26,21 +26,36 @@ public:
     virtual ~Player();
     void set_board(Board* board);
     virtual move get_move() = 0;
+    //called at the end of a game
+    virtual void print_statistics();
+    //0 if there is no limit (without a clock)
     void set_max_thinking_time(int seconds);
     void set_max_search_depth(int depth);
+    //0 if there is no limit.. a node limit replaces the time limit
+    void set_max_nodes(int nodes);
     void set_show_best_score(bool show);
     void set_show_thinking(bool show);
+    //number of the best root moves that are searched and shown (multi-PV)
+    void set_multi_pv(int lines);
     void set_xboard(bool xboard);
+    //number of threads of the search
+    void set_threads(int count);
+    //SMP_LAZY or SMP_SPLIT_POINTS
+    void set_parallel_search(int algorithm);
     string& get_name();
 protected:
     Board* board;
     string name;
     int max_thinking_time;
     int max_search_depth;
+    int max_nodes;
 
     bool show_best_score;
     bool show_thinking;
+    int multi_pv;
     bool xboard;
+    int threads;
+    int parallel_search;
 };
 
 #endif // PLAYER_H_
@@ -0,0 +1,1063 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#include "SearchThread.h"
+#include <sched.h>
+#include <cmath>
+
+using std::rotate;
+using std::find;
+
+search_parameters parameters = {
+    REVERSE_FUTILITY_MARGIN, FUTILITY_MARGIN, RAZOR_MARGIN
+};
+
+search_parameter parameter_list[] = {
+    {"reverse_futility", &parameters.reverse_futility, 0, 2000},
+    {"futility", &parameters.futility, 0, 2000},
+    {"razoring", &parameters.razoring, 0, 2000},
+    {NULL, NULL, 0, 0}
+};
+
+bool set_search_parameter(const string& assignment) {
+    size_t equals = assignment.find('=');
+    if (equals == string::npos) {
+        return false;
+    }
+    string name = assignment.substr(0, equals);
+    int value = atoi(assignment.substr(equals + 1).c_str());
+    for (search_parameter* p = parameter_list; p->name != NULL; p++) {
+        if (name == p->name && value >= p->min && value <= p->max) {
+            *p->value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+//reduction of a late move by [depth][move number], the same for all threads
+static bool reductions_initialized = false;
+static int reductions[LMR_DEPTHS][MAX_MOVES];
+
+static void initialize_reductions() {
+    if (!reductions_initialized) {
+        for (int depth = 1; depth < LMR_DEPTHS; depth++) {
+            for (int index = 1; index < MAX_MOVES; index++) {
+                reductions[depth][index] = (int) (0.75 + log((double) depth) * log((double) index) / 2.25);
+            }
+        }
+        reductions_initialized = true;
+    }
+}
+
+bool SplitPoint::cut() {
+    for (SplitPoint* sp = this; sp != NULL; sp = sp->parent) {
+        if (sp->cutoff) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SearchTeam::SearchTeam() : size(0), idle(0), done(false) {
+}
+
+SplitPoint* SearchTeam::find_work(SearchThread* thief) {
+    for (int i = 0; i < size; i++) {
+        SearchThread* other = threads[i];
+        if (other == thief || other->split_count == 0) {
+            continue;
+        }
+        pthread_mutex_lock(&other->splits_lock);
+        for (int j = 0; j < other->split_count; j++) {
+            SplitPoint* sp = other->splits[j];
+            if (sp->next < sp->moves.size() && !sp->cut()) {
+                __sync_fetch_and_add(&sp->workers, 1);
+                pthread_mutex_unlock(&other->splits_lock);
+                return sp;
+            }
+        }
+        pthread_mutex_unlock(&other->splits_lock);
+    }
+    return NULL;
+}
+
+SearchThread::SearchThread(int id) : id(id), ply(0), tablebase_draws(true), pv_length(0),
+follow_pv(false), root_move_number(0), root_moves(0), checked_nodes(0),
+quiescence_nodes(0), researches(0), node_limit(0), time_exit(false), team(NULL),
+split(NULL), split_count(0), tree(NULL), own_stop(false) {
+    memset(pv, 0, sizeof (pv));
+    memset(killers, 0, sizeof (killers));
+    memset(history, 0, sizeof (history));
+    memset(counter_moves, 0, sizeof (counter_moves));
+    memset(continuation, 0, sizeof (continuation));
+    root_best.move = 0;
+    root_move.move = 0;
+    stop = &own_stop;
+    pthread_mutex_init(&splits_lock, NULL);
+    initialize_reductions();
+}
+
+SearchThread::~SearchThread() {
+    pthread_mutex_destroy(&splits_lock);
+}
+
+void SearchThread::set_position(const Board& position) {
+    board = position;
+    ply = 0;
+    tablebase_draws = true;
+#ifdef USE_TABLEBASES
+    int score;
+    if (board.pieces <= TB_MAX_PIECES && tablebases.probe(board, 0, score) && score == DRAW) {
+        tablebase_draws = false;
+    }
+#endif
+}
+
+void SearchThread::reset(volatile bool* shared_stop, int nodes) {
+    node_limit = nodes;
+    own_stop = false;
+    stop = shared_stop != NULL ? shared_stop : &own_stop;
+    time_exit = false;
+    split = NULL;
+    split_count = 0;
+    ply = 0;
+    checked_nodes = 0;
+    quiescence_nodes = 0;
+    beta_cutoffs = 0;
+    first_move_cutoffs = 0;
+    memset(pv, 0, sizeof (pv));
+    pv_length = 0;
+    age_move_ordering();
+}
+
+/*
+ * The next search starts two plies later (after our move and the reply), so
+ * the killers move up by two plies. Old history counts are worth less.
+ */
+void SearchThread::age_move_ordering() {
+    for (int i = 0; i < MAX_PLY; i++) {
+        if (i + 2 < MAX_PLY) {
+            killers[i][0] = killers[i + 2][0];
+            killers[i][1] = killers[i + 2][1];
+        } else {
+            killers[i][0].move = 0;
+            killers[i][1].move = 0;
+        }
+    }
+    for (int color = 0; color < COLORS; color++) {
+        for (int from = 0; from < BOARD_SIZE; from++) {
+            for (int to = 0; to < BOARD_SIZE; to++) {
+                history[color][from][to] >>= 3;
+            }
+        }
+    }
+    int* counts = &continuation[0][0][0][0];
+    for (unsigned i = 0; i < sizeof (continuation) / sizeof (int); i++) {
+        counts[i] >>= 3;
+    }
+}
+
+static inline bool is_quiet(const move& m) {
+    return m.content == EMPTY && m.special != MOVE_PROMOTION;
+}
+
+/*
+ * Orders the captures and promotions in front of the list by MVV/LVA. The
+ * captures that lose material by the static exchange evaluation go behind
+ * the quiet moves, or out of the list if keep_losing is false. The quiet
+ * moves have to be sorted before.
+ */
+void SearchThread::sort_captures(vector<move>& moves, MoveGenerator& generator, bool keep_losing) {
+    int size = moves.size();
+    if (size > MAX_MOVES) {
+        return;
+    }
+    int quiet = 0;
+    while (quiet < size && !is_quiet(moves[quiet])) {
+        quiet++;
+    }
+    int scores[MAX_MOVES];
+    move losing[MAX_MOVES];
+    int losing_count = 0;
+    int good = 0;
+    for (int i = 0; i < quiet; i++) {
+        move m = moves[i];
+        //taking a piece of the same or higher value never loses
+        if (abs(m.content) < abs(m.moved_piece) && m.special != MOVE_PROMOTION
+                && generator.static_exchange(m) < 0) {
+            losing[losing_count++] = m;
+            continue;
+        }
+        int victim = abs(m.content);
+        if (m.special == MOVE_PROMOTION) {
+            victim += abs(m.promoted) - PAWN;
+        }
+        int score = victim * 8 - abs(m.moved_piece);
+        //insertion sort.. it keeps the generated order of equal moves
+        int j = good - 1;
+        while (j >= 0 && scores[j] < score) {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+            j--;
+        }
+        moves[j + 1] = m;
+        scores[j + 1] = score;
+        good++;
+    }
+    if (losing_count == 0) {
+        return;
+    }
+    for (int i = quiet; i < size; i++) {
+        moves[good + i - quiet] = moves[i];
+    }
+    int end = good + size - quiet;
+    if (keep_losing) {
+        for (int i = 0; i < losing_count; i++) {
+            moves[end + i] = losing[i];
+        }
+    } else {
+        moves.resize(end);
+    }
+}
+
+/*
+ * The last move of the opponent, NULL at the beginning of the game.
+ */
+const move* SearchThread::previous_move() {
+    if (board.history.empty() || board.history.back().m.moved_piece == EMPTY) {
+        return NULL;
+    }
+    return &board.history.back().m;
+}
+
+/*
+ * The quiet moves are at the end of the generated list. The killers of this
+ * ply go first, then the counter move of the opponent's last move, then the
+ * moves with the highest history count (of the move itself and as an answer
+ * to the last move).
+ */
+void SearchThread::sort_quiet_moves(vector<move>& moves) {
+    int size = moves.size();
+    int first = size;
+    while (first > 0 && is_quiet(moves[first - 1])) {
+        first--;
+    }
+    if (size - first < 2 || size > MAX_MOVES) {
+        return;
+    }
+    int color = board.to_move == WHITE ? 0 : 1;
+    const move* previous = previous_move();
+    move counter;
+    counter.move = 0;
+    int (*follow_up)[SQUARES] = NULL;
+    if (previous != NULL) {
+        int piece = PIECE_INDEX(previous->moved_piece);
+        int to = SQUARE_INDEX(previous->pos_new);
+        counter = counter_moves[piece][to];
+        follow_up = continuation[piece][to];
+    }
+    int scores[MAX_MOVES];
+    for (int i = first; i < size; i++) {
+        if (ply < MAX_PLY && moves[i] == killers[ply][0]) {
+            scores[i] = KILLER_SCORE + 2;
+        } else if (ply < MAX_PLY && moves[i] == killers[ply][1]) {
+            scores[i] = KILLER_SCORE + 1;
+        } else if (counter.move != 0 && moves[i] == counter) {
+            scores[i] = KILLER_SCORE;
+        } else {
+            scores[i] = history[color][moves[i].pos_old][moves[i].pos_new];
+            if (follow_up != NULL) {
+                scores[i] += follow_up[PIECE_INDEX(moves[i].moved_piece)][SQUARE_INDEX(moves[i].pos_new)];
+            }
+        }
+    }
+    //insertion sort.. it keeps the generated order of equal moves
+    for (int i = first + 1; i < size; i++) {
+        move m = moves[i];
+        int score = scores[i];
+        int j = i - 1;
+        while (j >= first && scores[j] < score) {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+            j--;
+        }
+        moves[j + 1] = m;
+        scores[j + 1] = score;
+    }
+}
+
+/*
+ * A quiet move caused a beta cutoff.
+ */
+void SearchThread::update_move_ordering(const move& m, int depth) {
+    if (!is_quiet(m)) {
+        return;
+    }
+    if (ply < MAX_PLY && !(m == killers[ply][0])) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = m;
+    }
+    int color = board.to_move == WHITE ? 0 : 1;
+    int& count = history[color][m.pos_old][m.pos_new];
+    count += depth * depth;
+    if (count > HISTORY_MAX) {
+        for (int c = 0; c < COLORS; c++) {
+            for (int from = 0; from < BOARD_SIZE; from++) {
+                for (int to = 0; to < BOARD_SIZE; to++) {
+                    history[c][from][to] >>= 1;
+                }
+            }
+        }
+    }
+
+    const move* previous = previous_move();
+    if (previous != NULL) {
+        int piece = PIECE_INDEX(previous->moved_piece);
+        int to = SQUARE_INDEX(previous->pos_new);
+        counter_moves[piece][to] = m;
+        int& pair = continuation[piece][to][PIECE_INDEX(m.moved_piece)][SQUARE_INDEX(m.pos_new)];
+        pair += depth * depth;
+        if (pair > HISTORY_MAX) {
+            int* counts = &continuation[0][0][0][0];
+            for (unsigned i = 0; i < sizeof (continuation) / sizeof (int); i++) {
+                counts[i] >>= 1;
+            }
+        }
+    }
+}
+
+int SearchThread::search(int depth, int alpha, int beta) {
+    follow_pv = true;
+    root_best.move = 0;
+    int score = alpha_beta(depth, alpha, beta);
+    if (!time_exit && root_best.move != 0) {
+        extract_pv(depth);
+    }
+    return score;
+}
+
+/*
+ * Searches with a narrow window around the score of the previous iteration.
+ * On a fail low or fail high the window is doubled on that side and the
+ * iteration is searched again. Mate scores always get the full window.
+ */
+int SearchThread::aspiration_search(int depth, int previous_score) {
+    researches = 0;
+    if (depth < ASPIRATION_MIN_DEPTH || abs(previous_score) >= MATE) {
+        return search(depth);
+    }
+    int delta = ASPIRATION_WINDOW;
+    int alpha = previous_score - delta;
+    int beta = previous_score + delta;
+    for (;;) {
+        int score = search(depth, alpha, beta);
+        if (time_exit || (score > alpha && score < beta)) {
+            return score;
+        }
+        researches++;
+        delta *= 2;
+        if (score <= alpha) {
+            alpha = score - delta;
+        } else {
+            beta = score + delta;
+        }
+        if (delta > ASPIRATION_MAX_WINDOW || alpha <= -MATE) {
+            alpha = -EVALUATION_START;
+        }
+        if (delta > ASPIRATION_MAX_WINDOW || beta >= MATE) {
+            beta = EVALUATION_START;
+        }
+    }
+}
+
+/*
+ * Iterative deepening of a helper thread. Odd helpers are one ply ahead, so
+ * the threads don't search the same tree at the same time.
+ */
+void SearchThread::iterate(int max_depth) {
+    int score = 0;
+    for (int depth = 1 + (id & 1); depth <= max_depth && !time_exit; depth++) {
+        score = aspiration_search(depth, score);
+        if (!time_exit && abs(score) >= MATE) {
+            break;
+        }
+    }
+}
+
+/*
+ * Helper of a split point search: joins the split points of the other
+ * threads until the search is over.
+ */
+void SearchThread::idle_loop() {
+    __sync_fetch_and_add(&team->idle, 1);
+    while (!team->done && !*stop) {
+        SplitPoint* sp = team->find_work(this);
+        if (sp == NULL) {
+            sched_yield();
+            continue;
+        }
+        __sync_fetch_and_sub(&team->idle, 1);
+        board = sp->board;
+        ply = sp->ply;
+        follow_pv = false;
+        split = sp;
+        work_on(sp);
+        split = NULL;
+        __sync_fetch_and_sub(&sp->workers, 1);
+        __sync_fetch_and_add(&team->idle, 1);
+    }
+    __sync_fetch_and_sub(&team->idle, 1);
+}
+
+/*
+ * Searches the moves of a split point, one at a time, until there are no more
+ * or one of them fails high.
+ */
+void SearchThread::work_on(SplitPoint* sp) {
+    for (;;) {
+        pthread_mutex_lock(&sp->lock);
+        if (sp->next >= sp->moves.size() || sp->cut()) {
+            pthread_mutex_unlock(&sp->lock);
+            return;
+        }
+        unsigned index = sp->next++;
+        move m = sp->moves[index];
+        int alpha = sp->alpha;
+        pthread_mutex_unlock(&sp->lock);
+
+        int reduction = late_move_reduction(sp->depth, index, m, sp->check, false);
+        make_move(m);
+        if (reduction > 0 && in_check()) {
+            reduction = 0;
+        }
+        int score = -alpha_beta(sp->depth - 1 - reduction, -alpha - 1, -alpha);
+        if (!stopped() && reduction > 0 && score > alpha) {
+            // the reduced search was wrong, search it again with the full depth
+            score = -alpha_beta(sp->depth - 1, -alpha - 1, -alpha);
+        }
+        if (!stopped() && score > alpha && score < sp->beta) {
+            // re-search
+            score = -alpha_beta(sp->depth - 1, -sp->beta, -alpha);
+        }
+        unmake_move();
+        if (stopped()) {
+            return;
+        }
+
+        pthread_mutex_lock(&sp->lock);
+        if (score > sp->alpha) {
+            sp->alpha = score;
+            sp->best = m;
+            if (score >= sp->beta) {
+                sp->cutoff = true;
+                beta_cutoffs++;
+                update_move_ordering(m, sp->depth);
+            }
+        }
+        pthread_mutex_unlock(&sp->lock);
+    }
+}
+
+/*
+ * Searches moves[1..] together with the idle threads. Returns the best score
+ * (alpha if nothing was better) and the best move in best.
+ */
+int SearchThread::search_split(int depth, int alpha, int beta, bool check, vector<move>& moves, move& best) {
+    SplitPoint sp;
+    sp.parent = split;
+    sp.owner = this;
+    sp.board = board;
+    sp.ply = ply;
+    sp.depth = depth;
+    sp.beta = beta;
+    sp.check = check;
+    sp.moves = moves;
+    pthread_mutex_init(&sp.lock, NULL);
+    sp.alpha = alpha;
+    sp.best = best;
+    sp.next = 1;
+    sp.workers = 1;
+    sp.cutoff = false;
+
+    pthread_mutex_lock(&splits_lock);
+    splits[split_count++] = &sp;
+    pthread_mutex_unlock(&splits_lock);
+
+    bool old_follow_pv = follow_pv;
+    follow_pv = false;
+    split = &sp;
+    work_on(&sp);
+    split = sp.parent;
+    follow_pv = old_follow_pv;
+
+    //nobody can join anymore.. wait for the helpers to finish their moves
+    pthread_mutex_lock(&splits_lock);
+    split_count--;
+    pthread_mutex_unlock(&splits_lock);
+    while (sp.workers > 1) {
+        sched_yield();
+    }
+    pthread_mutex_destroy(&sp.lock);
+
+    best = sp.best;
+    return sp.alpha;
+}
+
+/*
+ * The search never looks at the clock, the timer thread of the player sets
+ * the stop flag at the deadline. The flag is shared by all the threads of a
+ * search, so they stop together.
+ * The node limit doesn't depend on the clock, so such a search always ends
+ * at the same node.
+ */
+bool SearchThread::time_is_up() {
+    if (node_limit > 0 && checked_nodes >= node_limit) {
+        *stop = true;
+    }
+    if (*stop) {
+        time_exit = true;
+    }
+    return stopped();
+}
+
+void SearchThread::make_move(const move& m) {
+    board.fake_move(m);
+    ply++;
+}
+
+void SearchThread::unmake_move() {
+    board.unfake_move();
+    ply--;
+}
+
+/*
+ * Depth reduction of a late move, from the table. Only quiet moves that are
+ * not killers are reduced, and never when the side to move is in check.
+ * Moves that give check are found after they are played, see in_check().
+ */
+int SearchThread::late_move_reduction(int depth, unsigned index, const move& m, bool check, bool pv_node) {
+    if (check || depth < LMR_MIN_DEPTH || index < LMR_MIN_MOVES || !is_quiet(m)
+            || (ply < MAX_PLY && (m == killers[ply][0] || m == killers[ply][1]))) {
+        return 0;
+    }
+    int r = reductions[depth < LMR_DEPTHS ? depth : LMR_DEPTHS - 1][index < MAX_MOVES ? index : MAX_MOVES - 1];
+    if (pv_node && r > 0) {
+        r--;
+    }
+    // never drop straight into the quiescence search
+    if (r > depth - 2) {
+        r = depth - 2;
+    }
+    return r;
+}
+
+//is the side to move in check?
+bool SearchThread::in_check() {
+    MoveGenerator generator(&board);
+    return generator.check_for_check_simple();
+}
+
+void SearchThread::make_null_move() {
+    board.make_null_move();
+    ply++;
+}
+
+void SearchThread::unmake_null_move() {
+    board.unmake_null_move();
+    ply--;
+}
+
+/*
+ * Walks the transposition table from the root and puts the line into the PV.
+ * Every move of the table is matched against the legal moves of the position,
+ * and the line stops at a repetition, at a bound or a quiescence entry (their
+ * moves might be left from another line) and after depth moves. The root move
+ * comes from the search itself, so the PV never is empty.
+ */
+void SearchThread::extract_pv(int depth) {
+    Board temp_board = Board(board);
+    pv[0] = root_best;
+    pv_length = 1;
+    temp_board.fake_move(root_best);
+#ifdef USE_HASH_TABLE
+    htentry entry;
+    while (pv_length < depth && pv_length < MAX_PLY && !repetitions(&temp_board)
+            && hash_table.probe(temp_board.get_hash(), 0, entry)
+            && entry.type == EXACT && entry.depth > 0 && entry.best.move != 0) {
+        MoveGenerator generator(&temp_board);
+        generator.generate_all_moves();
+        vector<move>& moves = generator.get_all_moves();
+        sort_hash_move(moves, entry.best);
+        if (moves.empty() || !(moves[0] == entry.best)) {
+            break;
+        }
+        pv[pv_length++] = moves[0];
+        temp_board.fake_move(moves[0]);
+    }
+#endif
+}
+
+int SearchThread::alpha_beta(int depth, int alpha, int beta, bool null_move) {
+
+    if (depth == 0) {
+        return quiescence(alpha, beta);
+    }
+    checked_nodes++;
+
+    if (time_is_up()) {
+        return 0;
+    }
+
+    // mate distance pruning: we can't be mated before this ply and can't mate
+    // before the next one.. a shorter mate that is known already wins
+    if (ply > 0) {
+        if (alpha < MATED_IN(ply)) {
+            alpha = MATED_IN(ply);
+        }
+        if (beta > -MATED_IN(ply + 1)) {
+            beta = -MATED_IN(ply + 1);
+        }
+        if (alpha >= beta) {
+            return alpha;
+        }
+    }
+
+#ifdef USE_TABLEBASES
+    // the endings of the tablebases are known exactly
+    int tablebase_score;
+    if (ply > 0 && board.pieces <= TB_MAX_PIECES && tablebases.probe(board, ply, tablebase_score)
+            && (tablebase_score != DRAW || tablebase_draws)) {
+        return tablebase_score;
+    }
+#endif
+
+    int e = NO_EVAL;
+#ifdef USE_HASH_TABLE
+    // check for a hash entry, but never cut at the root.. we need a move there
+    move hash_move;
+    hash_move.move = 0;
+    htentry entry;
+    if (hash_table.probe(board.get_hash(), ply, entry)) {
+        hash_move = entry.best;
+        e = entry.eval;
+        if (ply > 0 && entry.depth >= depth) {
+            switch (entry.type) {
+                case EXACT:
+                    return entry.score;
+                case LOWER:
+                    if (entry.score >= beta) {
+                        return entry.score;
+                    }
+                    break;
+                case UPPER:
+                    if (entry.score <= alpha) {
+                        return entry.score;
+                    }
+                    break;
+                case NO:
+                    break;
+            }
+        }
+    }
+#endif // USE_HASH_TABLE
+
+    MoveGenerator generator(&board);
+    generator.generate_all_moves();
+    vector<move>& moves = generator.get_all_moves();
+
+    // multi-PV: the best moves of the root are known already. The root entry of
+    // the table is left alone then, it belongs to the whole position
+    bool store_root = true;
+    if (ply == 0 && !excluded_moves.empty()) {
+        store_root = false;
+        for (unsigned i = 0; i < excluded_moves.size(); i++) {
+            for (vector<move>::iterator it = moves.begin(); it != moves.end(); ++it) {
+                if (is_same_move(*it, excluded_moves[i])) {
+                    moves.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+
+    // are we in check? so we search deeper
+    bool check = generator.king_under_check;
+    if (check) {
+        depth++;
+    }
+
+    // If this is a root node, we can't just return 0, we need a move.
+    // else we check for a repetition and assume that this is a draw.
+    if (ply > 0 && repetitions(&board)) {
+        return DRAW;
+    }
+
+    // pruning by the static evaluation near the leaves, only off the PV, not
+    // in check and not when a mate score is in the window
+    bool futile = false;
+    if (ply > 0 && !check && beta - alpha == 1 && !follow_pv && depth <= REVERSE_FUTILITY_DEPTH
+            && alpha > -MATE && beta < MATE) {
+        if (e == NO_EVAL) {
+            e = evaluate(&board);
+        }
+        // reverse futility: too far above beta, the opponent won't let us get
+        // here
+        if (e - parameters.reverse_futility * depth >= beta) {
+            return e;
+        }
+        // razoring: too far below alpha, only the captures can help
+        if (depth <= RAZOR_DEPTH && e + parameters.razoring * depth <= alpha) {
+            int q = quiescence(alpha, beta);
+            if (q <= alpha) {
+                return q;
+            }
+        }
+        // futility: the quiet moves will not bring us to alpha
+        futile = depth <= FUTILITY_DEPTH && e + parameters.futility * depth <= alpha;
+    }
+
+#ifdef USE_NULL_MOVE
+    // null move: if we are still above beta after passing the turn, a real
+    // move will be even better. Not in check, not on the PV, and not when only
+    // pawns are left, because of the zugzwangs
+    if (null_move && ply > 0 && !check && !follow_pv && depth >= 2 && beta < MATE
+            && has_pieces(&board, board.to_move)) {
+        if (e == NO_EVAL) {
+            e = evaluate(&board);
+        }
+        if (e >= beta) {
+            int r = depth > NULL_MOVE_DEEP ? NULL_MOVE_REDUCTION + 1 : NULL_MOVE_REDUCTION;
+            int null_depth = depth - 1 - r > 0 ? depth - 1 - r : 0;
+            make_null_move();
+            int null_score = -alpha_beta(null_depth, -beta, -beta + 1, false);
+            unmake_null_move();
+            if (stopped()) {
+                return 0;
+            }
+#ifdef USE_NULL_MOVE_VERIFICATION
+            // the same node without the null move, at the reduced depth
+            if (null_score >= beta && depth >= NULL_MOVE_VERIFY_DEPTH) {
+                null_score = alpha_beta(depth - r, beta - 1, beta, false);
+                if (stopped()) {
+                    return 0;
+                }
+            }
+#endif
+            if (null_score >= beta) {
+                // a mate after passing the turn is not a real one
+                if (null_score >= MATE) {
+                    null_score = beta;
+                }
+#ifdef USE_HASH_TABLE
+                hash_table.store(board.get_hash(), ply, depth, LOWER, null_score, hash_move, e);
+#endif
+                return null_score;
+            }
+        }
+    }
+#endif
+
+#ifdef USE_HASH_TABLE
+    // internal iterative deepening: neither the table nor the PV knows a move
+    // here, so a reduced search finds one to start with
+    bool pv_node = beta - alpha > 1;
+    if (hash_move.move == 0 && !follow_pv && moves.size() > 1
+            && depth >= (pv_node ? IID_PV_DEPTH : IID_DEPTH)) {
+        alpha_beta(pv_node ? depth - 2 : depth / 2, alpha, beta, false);
+        if (stopped()) {
+            return 0;
+        }
+        if (hash_table.probe(board.get_hash(), ply, entry)) {
+            hash_move = entry.best;
+        }
+    }
+#endif
+
+    sort_quiet_moves(moves);
+    sort_captures(moves, generator, true);
+    //TODO: maybe it's better to use the get_all_moves(move best_move) from
+    // move generator, cause this function puts the best move in front without
+    // changing of the moves.. don't forget that they are sorted
+    if (follow_pv) {
+        sort_pv(moves);
+    }
+#ifdef USE_HASH_TABLE
+    if (!follow_pv && hash_move.move != 0) {
+        sort_hash_move(moves, hash_move);
+    }
+#endif
+    // helpers search the root moves after the best one in a different order
+    if (ply == 0 && id > 0 && moves.size() > 2) {
+        rotate(moves.begin() + 1, moves.begin() + 1 + id % (moves.size() - 1), moves.end());
+    }
+
+    bool played_move = false;
+    int score = 0;
+    bool pv_search = true;
+
+#ifdef USE_HASH_TABLE
+    int o_alpha = alpha;
+#endif
+    move best;
+    best.move = 0;
+
+    for (unsigned index = 0; index < moves.size(); index++) {
+        int reduction = late_move_reduction(depth, index, moves[index], check, beta - alpha > 1);
+        bool prune = futile && index > 0 && is_quiet(moves[index]);
+        if (ply == 0) {
+            root_move = moves[index];
+            root_move_number = index + 1;
+            root_moves = moves.size();
+        }
+        make_move(moves[index]);
+        if ((reduction > 0 || prune) && in_check()) {
+            reduction = 0;
+            prune = false;
+        }
+        if (prune) {
+            unmake_move();
+            continue;
+        }
+        played_move = true;
+        if (reduction > 0) {
+            // late move: a reduced null window search first, if it beats
+            // alpha the move is searched again with the full depth
+            score = -alpha_beta(depth - 1 - reduction, -alpha - 1, -alpha);
+        }
+        if (reduction == 0 || (score > alpha && !stopped())) {
+            if (pv_search) {
+                score = -alpha_beta(depth - 1, -beta, -alpha);
+            } else {
+                score = -alpha_beta(depth - 1, -alpha - 1, -alpha);
+                if (score > alpha && score < beta) {
+                    // re-search
+                    score = -alpha_beta(depth - 1, -beta, -alpha);
+                }
+            }
+        }
+        unmake_move();
+
+        // we have no time left
+        if (stopped()) {
+            return 0;
+        }
+
+        if (score > alpha) {
+            if (score >= beta) {
+                beta_cutoffs++;
+                if (index == 0) {
+                    first_move_cutoffs++;
+                }
+                update_move_ordering(moves[index], depth);
+#ifdef USE_HASH_TABLE
+                if (store_root) {
+                    hash_table.store(board.get_hash(), ply, depth, LOWER, score, moves[index]);
+                }
+#endif // USE_HASH_TABLE
+                return score;
+            }
+            alpha = score;
+
+            best = moves[index];
+            pv_search = false;
+
+            // the rest of the path is recovered from the hash table
+            if (ply == 0) {
+                root_best = moves[index];
+            }
+        }
+
+        // young brothers wait: the first move is searched, the others can be
+        // shared with the idle threads
+        if (index == 0 && team != NULL && team->idle > 0 && depth >= SPLIT_MIN_DEPTH
+                && moves.size() > 1 && split_count < MAX_PLY) {
+            score = search_split(depth, alpha, beta, check, moves, best);
+            if (stopped()) {
+                return 0;
+            }
+            if (score > alpha) {
+                if (ply == 0) {
+                    root_best = best;
+                }
+                if (score >= beta) {
+#ifdef USE_HASH_TABLE
+                    if (store_root) {
+                        hash_table.store(board.get_hash(), ply, depth, LOWER, score, best);
+                    }
+#endif // USE_HASH_TABLE
+                    return score;
+                }
+                alpha = score;
+            }
+            break;
+        }
+    }
+
+    // if we didn't played a move, we are either checkmate or stalemate
+    if (!played_move) {
+        if (check) {
+            return MATED_IN(ply);
+        }
+        return DRAW;
+    }
+
+    if (board.fifty_moves >= FIFTY_MOVES_RULE) {
+        return DRAW;
+    }
+#ifdef USE_HASH_TABLE
+    htype type = (alpha == o_alpha) ? UPPER : EXACT;
+    if (store_root) {
+        hash_table.store(board.get_hash(), ply, depth, type, alpha, best);
+    }
+#endif // USE_HASH_TABLE
+    return alpha;
+}
+
+int SearchThread::quiescence(int alpha, int beta) {
+
+    checked_nodes++;
+    quiescence_nodes++;
+
+    if (time_is_up()) {
+        return 0;
+    }
+
+#ifdef USE_TABLEBASES
+    int tablebase_score;
+    if (board.pieces <= TB_MAX_PIECES && tablebases.probe(board, ply, tablebase_score)
+            && (tablebase_score != DRAW || tablebase_draws)) {
+        return tablebase_score;
+    }
+#endif
+
+    int e = NO_EVAL;
+#ifdef USE_HASH_TABLE
+    // the same captures are reached by transposition all the time.. any entry
+    // is deep enough here, and it might know the evaluation or the best capture
+    move hash_move;
+    hash_move.move = 0;
+    htentry entry;
+    if (hash_table.probe(board.get_hash(), ply, entry)) {
+        switch (entry.type) {
+            case EXACT:
+                return entry.score;
+            case LOWER:
+                if (entry.score >= beta) {
+                    return entry.score;
+                }
+                break;
+            case UPPER:
+                if (entry.score <= alpha) {
+                    return entry.score;
+                }
+                break;
+            case NO:
+                break;
+        }
+        hash_move = entry.best;
+        e = entry.eval;
+    }
+#endif
+
+    // check with the evaluation function
+    if (e == NO_EVAL) {
+        e = evaluate(&board);
+    }
+    if (e >= beta) {
+#ifdef USE_HASH_TABLE
+        hash_table.store(board.get_hash(), ply, 0, LOWER, e, hash_move, e);
+#endif
+        return beta;
+    }
+    int o_alpha = alpha;
+    if (e > alpha) {
+        alpha = e;
+    }
+
+    MoveGenerator generator(&board);
+    generator.generate_all_moves();
+    vector<move> moves;
+    generator.get_all_capture_moves(moves);
+    // the captures that lose material are not searched at all
+    sort_captures(moves, generator, false);
+
+#ifdef USE_HASH_TABLE
+    if (hash_move.move != 0) {
+        sort_hash_move(moves, hash_move);
+    }
+#endif
+    move best;
+    best.move = 0;
+
+    for (vector<move>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
+        // delta pruning: even the captured piece won't bring us close to alpha
+        if (it->special != MOVE_PROMOTION
+                && e + exchange_values[abs(it->content)] + DELTA_MARGIN <= alpha) {
+            continue;
+        }
+        make_move(*it);
+        int score = -quiescence(-beta, -alpha);
+        unmake_move();
+
+        // we have no time left
+        if (stopped()) {
+            return 0;
+        }
+
+        if (score > alpha) {
+            if (score >= beta) {
+#ifdef USE_HASH_TABLE
+                hash_table.store(board.get_hash(), ply, 0, LOWER, score, *it, e);
+#endif
+                return beta;
+            }
+            alpha = score;
+            best = *it;
+        }
+    }
+#ifdef USE_HASH_TABLE
+    htype type = (alpha == o_alpha) ? UPPER : EXACT;
+    hash_table.store(board.get_hash(), ply, 0, type, alpha, best, e);
+#endif
+    return alpha;
+}
+
+void SearchThread::sort_pv(vector<move>& moves) {
+    follow_pv = false;
+    for (unsigned i = 0; i < moves.size(); i++) {
+        if (ply < pv_length && moves[i] == pv[ply]) {
+            follow_pv = true;
+            move tmp = moves[0];
+            moves[0] = moves[i];
+            moves[i] = tmp;
+            return;
+        }
+    }
+}
+
+/*
+ * Puts the move from the transposition table in front. The table only knows
+ * the squares (and the promoted piece) of the move.
+ */
+void SearchThread::sort_hash_move(vector<move>& moves, move hash_move) {
+    for (unsigned i = 0; i < moves.size(); i++) {
+        if (moves[i] == hash_move && (hash_move.special != MOVE_PROMOTION
+                || abs(moves[i].promoted) == abs(hash_move.promoted))) {
+            move tmp = moves[0];
+            moves[0] = moves[i];
+            moves[i] = tmp;
+            return;
+        }
+    }
+}
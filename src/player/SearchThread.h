@@ -0,0 +1,231 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#ifndef SEARCHTHREAD_H_
+#define SEARCHTHREAD_H_
+
+#include <algorithm>
+#include <pthread.h>
+#include "../common/define.h"
+#include "../common/utils.h"
+#include "../model/Board.h"
+#include "../model/MoveGenerator.h"
+#include "../model/evaluate.h"
+#include "../model/HashTable.h"
+#include "../model/Tablebase.h"
+
+class SearchThread;
+class MonteCarloTree;
+
+/*
+ * Margins of the pruning near the leaves, per ply of the remaining depth.
+ * They are shared by all the players and can be changed at runtime with
+ * -param, in the settings of the CLI or as xboard options.
+ */
+typedef struct {
+    int reverse_futility;
+    int futility;
+    int razoring;
+} search_parameters;
+
+typedef struct {
+    const char* name;
+    int* value;
+    int min;
+    int max;
+} search_parameter;
+
+extern search_parameters parameters;
+//all the parameters by name, the last one has a NULL name
+extern search_parameter parameter_list[];
+
+//"name=value".. returns false if the name is unknown or the value is out of range
+bool set_search_parameter(const string& assignment);
+
+/*
+ * Node of the tree where the remaining moves are searched by several threads
+ * (young brothers wait: only after the first move has been searched). It lives
+ * on the stack of the owner, which doesn't return before all the helpers have
+ * left it.
+ */
+class SplitPoint {
+public:
+    SplitPoint* parent;
+    SearchThread* owner;
+    Board board;
+    int ply;
+    int depth;
+    int beta;
+    bool check;
+    vector<move> moves;
+
+    //shared by all the threads of the split point, protected by lock
+    pthread_mutex_t lock;
+    volatile int alpha;
+    move best;
+    volatile unsigned next;
+    volatile int workers;
+    volatile bool cutoff;
+
+    //true if this or any split point above had a beta cutoff
+    bool cut();
+};
+
+/*
+ * Threads of a split point search. Idle threads steal moves from the split
+ * points of the others, oldest (closest to the root) first.
+ */
+class SearchTeam {
+public:
+    SearchTeam();
+
+    SearchThread* threads[MAX_THREADS];
+    int size;
+    volatile int idle;
+    volatile bool done;
+
+    SplitPoint* find_work(SearchThread* thief);
+};
+
+/*
+ * State of one search: its own copy of the position, the distance from the
+ * root, the node counters, the PV and the move ordering (killer moves, counter
+ * moves and the history tables, they are kept between the searches).
+ *
+ * Nothing of it is shared with the board of the game or with other searches
+ * (only the transposition table and the stop flag are), so several of them can
+ * run at the same time on the same position. Thread 0 is the main thread, the
+ * others are helpers of a parallel search.
+ *
+ * Every thread has a deque of its open split points: the owner pushes and pops
+ * at the bottom, the other threads of the team steal at the top.
+ */
+class SearchThread {
+public:
+    SearchThread(int id = 0);
+    ~SearchThread();
+
+    //copies the position, the search never changes the board of the game
+    void set_position(const Board& position);
+    //has to be called before every search, all the threads of a search share
+    //the stop flag (it's set by the timer of the player).. with a node limit
+    //the thread stops itself after that many nodes
+    void reset(volatile bool* stop = NULL, int node_limit = 0);
+
+    //one iteration from the root, the best move ends up in pv[0]
+    int search(int depth, int alpha = -EVALUATION_START, int beta = EVALUATION_START);
+    //the same, with an aspiration window around the previous score
+    int aspiration_search(int depth, int previous_score);
+    //iterative deepening of a helper thread, until it's stopped
+    void iterate(int max_depth);
+    //a helper of a split point search waits here for work
+    void idle_loop();
+    //null_move is false right after a null move, we never pass twice
+    int alpha_beta(int depth, int alpha, int beta, bool null_move = true);
+    int quiescence(int alpha, int beta);
+    //plays a move on the board of the thread, one ply deeper
+    void make_move(const move& m);
+    void unmake_move();
+
+    //the line of the last iteration, at most depth moves
+    void extract_pv(int depth);
+
+    static void sort_hash_move(vector<move>& moves, move hash_move);
+
+    int id;
+    Board board;
+    //distance from the root
+    int ply;
+    //false if the root is a drawn ending of the tablebases already.. then
+    //the drawn positions are searched on, so the material is kept and a
+    //mistake of the opponent can still be found
+    bool tablebase_draws;
+
+    //principal variation of the last iteration (from the transposition table)
+    move pv[MAX_PLY];
+    int pv_length;
+    bool follow_pv;
+    //best move of the root in the current iteration
+    move root_best;
+    //move of the root that is searched now, its number and all the moves
+    //(for the status of the analysis)
+    move root_move;
+    int root_move_number;
+    int root_moves;
+    //moves of the root that are not searched (the better lines of multi-PV)
+    vector<move> excluded_moves;
+
+    //number of checked nodes in a current search
+    int checked_nodes;
+    //..and how many of them were in the quiescence search
+    int quiescence_nodes;
+    //beta cutoffs in alpha_beta, and how many of them on the first move
+    int beta_cutoffs;
+    int first_move_cutoffs;
+    //re-searches of the last aspiration_search()
+    int researches;
+
+    //0 if there is no limit
+    int node_limit;
+    //flag to stop the search on a time exit
+    bool time_exit;
+    volatile bool* stop;
+
+    //NULL if the thread is not part of a split point search
+    SearchTeam* team;
+    //split point we are working for at the moment
+    SplitPoint* split;
+    //open split points of this thread
+    SplitPoint* splits[MAX_PLY];
+    volatile int split_count;
+    pthread_mutex_t splits_lock;
+
+    //NULL if the thread is not running playouts of a Monte Carlo tree search
+    MonteCarloTree* tree;
+
+    //time is up, or some other thread refuted a split point above us
+    bool stopped() {
+        return time_exit || (split != NULL && split->cut());
+    }
+
+private:
+    volatile bool own_stop;
+
+    //two quiet moves per ply that caused a beta cutoff
+    move killers[MAX_PLY][2];
+    //butterfly table of the quiet moves that caused a beta cutoff
+    int history[COLORS][BOARD_SIZE][BOARD_SIZE];
+    //the same, but for the previous move of the opponent [piece][to]: the
+    //last quiet move that refuted it, and the counts of the pairs of moves
+    move counter_moves[PIECE_INDEXES][SQUARES];
+    int continuation[PIECE_INDEXES][SQUARES][PIECE_INDEXES][SQUARES];
+
+    void age_move_ordering();
+    void sort_quiet_moves(vector<move>& moves);
+    void sort_captures(vector<move>& moves, MoveGenerator& generator, bool keep_losing);
+    void update_move_ordering(const move& m, int depth);
+    const move* previous_move();
+
+    int late_move_reduction(int depth, unsigned index, const move& m, bool check, bool pv_node);
+    bool in_check();
+
+    int search_split(int depth, int alpha, int beta, bool check, vector<move>& moves, move& best);
+    void work_on(SplitPoint* sp);
+
+    bool time_is_up();
+    void make_null_move();
+    void unmake_null_move();
+    void sort_pv(vector<move>& moves);
+};
+
+#endif /* SEARCHTHREAD_H_ */
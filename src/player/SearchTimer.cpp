@@ -0,0 +1,74 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#include "SearchTimer.h"
+#include <errno.h>
+
+SearchTimer::SearchTimer() : flag(NULL), running(false), cancelled(false) {
+    pthread_mutex_init(&lock, NULL);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+}
+
+SearchTimer::~SearchTimer() {
+    stop();
+    pthread_cond_destroy(&wake);
+    pthread_mutex_destroy(&lock);
+}
+
+void SearchTimer::start(int deadline_ms, volatile bool* stop_flag) {
+    stop();
+    int wait = deadline_ms - get_ms();
+    if (wait < 0) {
+        wait = 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += wait / 1000;
+    deadline.tv_nsec += (long) (wait % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    flag = stop_flag;
+    cancelled = false;
+    running = true;
+    pthread_create(&thread, NULL, run, this);
+}
+
+void SearchTimer::stop() {
+    if (!running) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    cancelled = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    running = false;
+}
+
+void* SearchTimer::run(void* data) {
+    SearchTimer* timer = (SearchTimer*) data;
+    pthread_mutex_lock(&timer->lock);
+    while (!timer->cancelled) {
+        if (pthread_cond_timedwait(&timer->wake, &timer->lock, &timer->deadline) == ETIMEDOUT) {
+            *timer->flag = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&timer->lock);
+    return NULL;
+}
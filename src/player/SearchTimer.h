@@ -0,0 +1,49 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#ifndef SEARCHTIMER_H_
+#define SEARCHTIMER_H_
+
+#include <pthread.h>
+#include <time.h>
+#include "../common/define.h"
+#include "../common/utils.h"
+
+/*
+ * Thread that sets the stop flag of a search at its deadline. It waits on
+ * the monotonic clock, so the search only has to check the flag and stops
+ * right at the deadline no matter how fast it searches.
+ */
+class SearchTimer {
+public:
+    SearchTimer();
+    ~SearchTimer();
+
+    //sets *flag at the deadline (in get_ms() time), unless stopped before
+    void start(int deadline, volatile bool* flag);
+    //cancels the timer if it's still waiting
+    void stop();
+
+private:
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    struct timespec deadline;
+    volatile bool* flag;
+    bool running;
+    bool cancelled;
+
+    static void* run(void* data);
+};
+
+#endif /* SEARCHTIMER_H_ */
@@ -0,0 +1,115 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#include "TimeManager.h"
+
+TimeManager::TimeManager() : level_moves(0), level_base(0), level_increment(0),
+remaining(0), opponent_remaining(0), clock(false), soft_limit(0), hard_limit(0),
+stable_iterations(0), previous_score(0), first_iteration(true) {
+}
+
+void TimeManager::set_level(int moves, int base, int increment) {
+    level_moves = moves;
+    level_base = base;
+    level_increment = increment;
+    remaining = base;
+    opponent_remaining = base;
+    clock = base > 0 || increment > 0;
+}
+
+void TimeManager::set_time(int new_remaining) {
+    remaining = new_remaining;
+}
+
+void TimeManager::set_opponent_time(int new_remaining) {
+    opponent_remaining = new_remaining;
+}
+
+bool TimeManager::has_clock() {
+    return clock;
+}
+
+int TimeManager::get_soft_limit() {
+    return soft_limit;
+}
+
+int TimeManager::get_hard_limit() {
+    return hard_limit;
+}
+
+void TimeManager::start_move(int moves_played, int fixed_time) {
+    stable_iterations = 0;
+    previous_score = 0;
+    first_iteration = true;
+    if (!clock) {
+        soft_limit = fixed_time;
+        hard_limit = fixed_time;
+        return;
+    }
+    int moves_to_go = TIME_MOVES_TO_GO;
+    if (level_moves > 0) {
+        moves_to_go = level_moves - moves_played % level_moves;
+    }
+    int usable = remaining - TIME_SAFETY_MARGIN;
+    if (usable < 0) {
+        usable = 0;
+    }
+    soft_limit = usable / moves_to_go + level_increment * 3 / 4;
+    //we are behind on the clock.. save some time for later
+    if (remaining < opponent_remaining) {
+        soft_limit = soft_limit * 3 / 4 + (int) ((long long) soft_limit * remaining / opponent_remaining / 4);
+    }
+    hard_limit = soft_limit * TIME_HARD_FACTOR;
+    //on the last move before the time control everything is left
+    int most = moves_to_go > 1 ? usable / 4 + level_increment : usable * 3 / 4;
+    if (hard_limit > most) {
+        hard_limit = most;
+    }
+    if (hard_limit > usable) {
+        hard_limit = usable;
+    }
+    //the increment only comes back after the move.. don't spend more of it
+    //than there is on the clock
+    int increment = level_increment < remaining ? level_increment : remaining;
+    int least = TIME_MINIMUM + (increment > 0 ? increment / 2 : 0);
+    if (hard_limit < least) {
+        hard_limit = least;
+    }
+    if (soft_limit > hard_limit) {
+        soft_limit = hard_limit;
+    }
+}
+
+bool TimeManager::next_iteration(int elapsed, int iteration_time, bool best_move_changed, int score) {
+    if (!clock) {
+        return true;
+    }
+    stable_iterations = best_move_changed ? 0 : stable_iterations + 1;
+    int limit = soft_limit;
+    if (stable_iterations >= TIME_STABLE_ITERATIONS) {
+        limit = soft_limit / 2;
+    }
+    if (!first_iteration && score < previous_score - TIME_SCORE_DROP) {
+        limit = soft_limit * 2;
+    }
+    first_iteration = false;
+    previous_score = score;
+    if (limit > hard_limit) {
+        limit = hard_limit;
+    }
+    //don't start an iteration that can't finish before the hard limit
+    if (elapsed + iteration_time * TIME_BRANCHING > hard_limit) {
+        return false;
+    }
+    return elapsed < limit;
+}
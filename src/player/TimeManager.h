@@ -0,0 +1,68 @@
+/*
+ * This file is part of the chess-at-nite project [chess-at-nite.googlecode.com]
+ *
+ * Copyright (c) 2009-2010 by
+ *   Franziskus Domig
+ *   Panayiotis Lipiridis
+ *   Radoslav Petrik
+ *   Thai Gia Tuong
+ *
+ * For the full copyright and license information, please visit:
+ *   http://chess-at-nite.googlecode.com/svn/trunk/doc/LICENSE
+ */
+
+#ifndef TIMEMANAGER_H_
+#define TIMEMANAGER_H_
+
+#include "../common/define.h"
+
+/*
+ * Thinking time of a move from the clock of the game.
+ *
+ * Without a clock every move gets a fixed time. With a clock (the "level"
+ * and "time" commands of xboard) a move gets a soft limit, which is the
+ * planned time, and a hard limit, where the search is stopped in any case.
+ * Between the iterations next_iteration() decides if the search goes on:
+ * a stable best move stops it earlier, a dropping score gives it more time,
+ * and an iteration that can't finish before the hard limit is not started.
+ */
+class TimeManager {
+public:
+    TimeManager();
+
+    //moves per time control (0 if the whole game), base time and increment in ms..
+    //no base and no increment turns the clock off
+    void set_level(int moves, int base, int increment);
+    //remaining time on our clock and on the opponent's in ms (the clock is
+    //only used after set_level, xboard sends the time with "st" too)
+    void set_time(int remaining);
+    void set_opponent_time(int remaining);
+    bool has_clock();
+
+    //limits of a move, moves_played is the number of our moves since the
+    //start of the game.. fixed_time (in ms) is used if there is no clock
+    void start_move(int moves_played, int fixed_time);
+    int get_soft_limit();
+    int get_hard_limit();
+
+    //after every finished iteration: the time since the start of the move,
+    //the time of the iteration, if the best move changed and the score
+    bool next_iteration(int elapsed, int iteration_time, bool best_move_changed, int score);
+
+private:
+    int level_moves;
+    int level_base;
+    int level_increment;
+    int remaining;
+    int opponent_remaining;
+    bool clock;
+
+    int soft_limit;
+    int hard_limit;
+    //iterations without a change of the best move
+    int stable_iterations;
+    int previous_score;
+    bool first_iteration;
+};
+
+#endif /* TIMEMANAGER_H_ */